@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "army.h"
+
+// Case-insensitive lookup in the item catalog
+const ITEM *find_item(const char *name) {
+    for (int i = 0; i < NUMBER_OF_ITEMS; i++) {
+        if (strcasecmp(items[i].name, name) == 0) return &items[i];
+    }
+    return NULL;
+}
+
+// Strips leading and trailing whitespace in place
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+const char *army_error(int code) {
+    switch (code) {
+        case ERR_UNIT_COUNT: return "an army needs 1 to 5 units";
+        case ERR_ITEM_COUNT: return "a unit needs one or two items";
+        case ERR_WRONG_ITEM: return "unknown item";
+        case ERR_SLOTS:      return "items need more than 2 slots";
+        case ERR_SYNTAX:     return "expected \"Name: Item[, Item]\"";
+        default:             return "invalid army";
+    }
+}
+
+// Parses "Name: Item[, Item]" with the same rules as the interactive setup
+int parse_unit(const char *text, UNIT *unit) {
+    char buf[256];
+    if (strlen(text) >= sizeof(buf)) return ERR_SYNTAX;
+    strcpy(buf, text);
+
+    char *colon = strchr(buf, ':');
+    if (!colon) return ERR_SYNTAX;
+    *colon = '\0';
+    char *name = trim(buf);
+    if (*name == '\0' || strlen(name) > MAX_NAME) return ERR_SYNTAX;
+
+    const ITEM *picked[2] = {NULL, NULL};
+    int count = 0, slots = 0;
+    char *save;
+    for (char *tok = strtok_r(colon + 1, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        tok = trim(tok);
+        if (count == 2 || *tok == '\0') return ERR_ITEM_COUNT;
+        const ITEM *item = find_item(tok);
+        if (!item) return ERR_WRONG_ITEM;
+        slots += item->slots;
+        picked[count++] = item;
+    }
+    if (count == 0) return ERR_ITEM_COUNT;
+    if (slots > 2) return ERR_SLOTS;
+
+    memset(unit, 0, sizeof(*unit));
+    strcpy(unit->name, name);
+    unit->item1 = picked[0];
+    unit->item2 = picked[1];
+    unit->hp = UNIT_HP;
+    return 0;
+}
+
+static Army *add_army(Roster *roster, const char *name) {
+    if (roster->count == roster->capacity) {
+        int capacity = roster->capacity ? roster->capacity * 2 : 16;
+        Army *armies = realloc(roster->armies, capacity * sizeof(Army));
+        if (!armies) return NULL;
+        roster->armies = armies;
+        roster->capacity = capacity;
+    }
+    Army *army = &roster->armies[roster->count++];
+    memset(army, 0, sizeof(*army));
+    snprintf(army->name, sizeof(army->name), "%s", name);
+    return army;
+}
+
+// Appends the armies in `path` to the roster. On failure err holds
+// "file:line: reason" and the return value is one of the ERR_* codes.
+int load_roster(const char *path, Roster *roster, char *err, size_t err_len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(err, err_len, "%s: cannot open", path);
+        return ERR_SYNTAX;
+    }
+
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    char line[256];
+    int lineno = 0, result = 0;
+    int first = roster->count;
+    Army *army = NULL;
+    while (result == 0 && fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *text = trim(line);
+        if (*text == '\0' || *text == '#') continue;
+
+        if (*text == '[') {
+            char *close = strchr(text, ']');
+            if (!close || close[1] != '\0') {
+                result = ERR_SYNTAX;
+                break;
+            }
+            *close = '\0';
+            if (army && army->count == 0) {
+                result = ERR_UNIT_COUNT;
+                break;
+            }
+            army = add_army(roster, trim(text + 1));
+            if (!army) result = ERR_UNIT_COUNT;
+            continue;
+        }
+
+        if (!army) army = add_army(roster, base);
+        if (!army) {
+            result = ERR_UNIT_COUNT;
+        } else if (army->count == MAX_ARMY) {
+            result = ERR_UNIT_COUNT;
+        } else {
+            result = parse_unit(text, &army->units[army->count]);
+            if (result == 0) army->count++;
+        }
+    }
+    fclose(f);
+
+    if (result == 0 && (roster->count == first || roster->armies[roster->count - 1].count == 0)) {
+        lineno++;
+        result = ERR_UNIT_COUNT;
+    }
+    if (result != 0) {
+        snprintf(err, err_len, "%s:%d: %s", path, lineno, army_error(result));
+        roster->count = first;
+    }
+    return result;
+}
+
+void free_roster(Roster *roster) {
+    free(roster->armies);
+    roster->armies = NULL;
+    roster->count = roster->capacity = 0;
+}
+
+int load_army(const char *spec, Army *army, char *err, size_t err_len) {
+    if (access(spec, R_OK) == 0) {
+        Roster roster = {0};
+        int result = load_roster(spec, &roster, err, err_len);
+        if (result == 0 && roster.count != 1) {
+            snprintf(err, err_len, "%s: holds %d armies, expected one", spec, roster.count);
+            result = ERR_UNIT_COUNT;
+        }
+        if (result == 0) *army = roster.armies[0];
+        free_roster(&roster);
+        return result;
+    }
+
+    char buf[1024];
+    if (strlen(spec) >= sizeof(buf)) {
+        snprintf(err, err_len, "army definition too long");
+        return ERR_SYNTAX;
+    }
+    strcpy(buf, spec);
+
+    memset(army, 0, sizeof(*army));
+    snprintf(army->name, sizeof(army->name), "Command line");
+    char *save;
+    for (char *tok = strtok_r(buf, ";", &save); tok; tok = strtok_r(NULL, ";", &save)) {
+        tok = trim(tok);
+        if (*tok == '\0') continue;
+        int result = army->count == MAX_ARMY ? ERR_UNIT_COUNT : parse_unit(tok, &army->units[army->count]);
+        if (result != 0) {
+            snprintf(err, err_len, "\"%s\": %s", tok, army_error(result));
+            return result;
+        }
+        army->count++;
+    }
+    if (army->count == 0) {
+        snprintf(err, err_len, "\"%s\": not a readable file or an army definition", spec);
+        return ERR_UNIT_COUNT;
+    }
+    return 0;
+}
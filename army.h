@@ -0,0 +1,48 @@
+#ifndef ARMY_H
+#define ARMY_H
+
+#include <stddef.h>
+#include "data.h"
+
+// Error codes for when an army definition is wrong
+#define ERR_UNIT_COUNT  (-1)    // Too many or too few units
+#define ERR_ITEM_COUNT  (-2)    // Problem with items
+#define ERR_WRONG_ITEM  (-3)    // Invalid item selected
+#define ERR_SLOTS       (-4)    // Not enough inventory slots
+#define ERR_SYNTAX      (-5)    // Line is not "Name: Item[, Item]"
+
+#define ARMY_NAME_MAX 63
+#define UNIT_HP 100             // Every unit starts at full health
+
+typedef struct {
+    char name[ARMY_NAME_MAX + 1];
+    UNIT units[MAX_ARMY];
+    int count;
+} Army;
+
+// Armies read from a roster file, in file order
+typedef struct {
+    Army *armies;
+    int count;
+    int capacity;
+} Roster;
+
+// Roster files hold one unit per line, grouped under [Army name] headers:
+//
+//     # Comments and blank lines are skipped
+//     [Knights]
+//     Arthur: Greatsword
+//     Robin: Bow, Dagger
+//
+// Unit lines before the first header form an army named after the file.
+const ITEM *find_item(const char *name);
+int parse_unit(const char *text, UNIT *unit);
+const char *army_error(int code);
+int load_roster(const char *path, Roster *roster, char *err, size_t err_len);
+void free_roster(Roster *roster);
+
+// A single army, either from a file in roster format holding one army or
+// inline, with units separated by semicolons: "Arthur: Sword; Robin: Bow"
+int load_army(const char *spec, Army *army, char *err, size_t err_len);
+
+#endif // ARMY_H
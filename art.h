@@ -0,0 +1,17 @@
+#ifndef ART_H
+#define ART_H
+
+// Menu art compiled into the binary (art_data.c is generated by the Makefile
+// from the .txt files). Lines are already cleaned up the way load_art cleans
+// files it reads.
+typedef struct {
+    const char *file;           // Name of the file this came from
+    int width;                  // Widest line, in screen columns
+    int height;
+    const char *const *lines;
+} ArtAsset;
+
+extern const ArtAsset art_assets[];
+extern const int art_asset_count;
+
+#endif // ART_H
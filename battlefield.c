@@ -3,6 +3,11 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include "battlefield.h"
+#include "render.h"
+#include "cast.h"
+#include "popup.h"
+#include "trace.h"
+#include "eventlog.h"
 
 // Utility macros
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
@@ -12,10 +17,216 @@ int manhattan_distance(int x1, int y1, int x2, int y2) {
     return abs(x1 - x2) + abs(y1 - y2);
 }
 
+// Cells within Manhattan distance r of each cell, the cell itself included
+static Bitboard range_masks[MAX_ATTACK_RANGE + 1][BOARD_CELLS];
+
+static void build_blast_stencils(void);
+
+// Cells a shot passes over on its way to a target at offset (dx, dy), the two
+// ends left out. Where the line runs exactly between two cells there are two
+// ways to round it, and the shot gets through if either one is clear.
+typedef struct {
+    int count;
+    bool tie;                               // The second rounding differs
+    signed char dx[2][MAX_ATTACK_RANGE];
+    signed char dy[2][MAX_ATTACK_RANGE];
+} LosRay;
+
+#define LOS_SIDE (2 * MAX_ATTACK_RANGE + 1)
+static LosRay los_rays[LOS_SIDE][LOS_SIDE];  // Indexed [dy + range][dx + range]
+
+// Walks the major axis one cell at a time and rounds the minor one, like
+// Bresenham; exact halves go down for the first rounding and up for the second
+static void build_los_rays(void) {
+    for (int dy = -MAX_ATTACK_RANGE; dy <= MAX_ATTACK_RANGE; dy++) {
+        for (int dx = -MAX_ATTACK_RANGE; dx <= MAX_ATTACK_RANGE; dx++) {
+            if (abs(dx) + abs(dy) > MAX_ATTACK_RANGE) continue;
+            LosRay *ray = &los_rays[dy + MAX_ATTACK_RANGE][dx + MAX_ATTACK_RANGE];
+            int steps = MAX(abs(dx), abs(dy));
+            bool x_major = abs(dx) >= abs(dy);
+            int major_sign = (x_major ? dx : dy) < 0 ? -1 : 1;
+            int minor = x_major ? dy : dx;
+            for (int i = 1; i < steps; i++) {
+                // minor * i / steps, rounded to the nearest cell both ways
+                int twice = 2 * abs(minor) * i;
+                int down = twice / (2 * steps) + (twice % (2 * steps) > steps);
+                int up = (twice + steps) / (2 * steps);
+                int sign = minor < 0 ? -1 : 1;
+                for (int side = 0; side < 2; side++) {
+                    int m = sign * (side ? up : down);
+                    ray->dx[side][ray->count] = (signed char)(x_major ? major_sign * i : m);
+                    ray->dy[side][ray->count] = (signed char)(x_major ? m : major_sign * i);
+                }
+                if (up != down) ray->tie = true;
+                ray->count++;
+            }
+        }
+    }
+}
+
+// Fills the lookup tables once, before main() and any other thread runs
+__attribute__((constructor))
+static void build_board_tables(void) {
+    for (int y = 0; y < MAX_GRID_HEIGHT; y++) {
+        for (int x = 0; x < MAX_GRID_WIDTH; x++) {
+            for (int ty = 0; ty < MAX_GRID_HEIGHT; ty++) {
+                for (int tx = 0; tx < MAX_GRID_WIDTH; tx++) {
+                    int dist = manhattan_distance(x, y, tx, ty);
+                    for (int r = dist; r <= MAX_ATTACK_RANGE; r++) {
+                        range_masks[r][y * MAX_GRID_WIDTH + x] |= cell_bit(tx, ty);
+                    }
+                }
+            }
+        }
+    }
+    build_blast_stencils();
+    build_los_rays();
+}
+
+Bitboard range_mask(int x, int y, int range) {
+    if (range < 0) return 0;
+    return range_masks[MIN(range, MAX_ATTACK_RANGE)][y * MAX_GRID_WIDTH + x];
+}
+
+Bitboard enemy_cells(const Battlefield *bf, int team) {
+    if (team == 1) return bf->occupied[1];
+    if (team == 2) return bf->occupied[0];
+    return bf->occupied[0] | bf->occupied[1];
+}
+
+// Cells reachable from (x, y) for at most `budget` movement points, without
+// passing through units or impassable terrain. Dijkstra with one bucket per
+// cost: bucket d holds the cells first reached for d points, and every step
+// costs at least one, so the search never leaves range_mask(x, y, budget).
+Bitboard reachable_cells(const Battlefield *bf, int x, int y, int budget) {
+    static const int step_x[4] = {1, -1, 0, 0}, step_y[4] = {0, 0, 1, -1};
+    Bitboard closed = bf->impassable | bf->occupied[0] | bf->occupied[1];
+    Bitboard buckets[MAX_ATTACK_RANGE + 1] = {0};
+    Bitboard settled = cell_bit(x, y), reached = 0;
+    budget = MIN(budget, MAX_ATTACK_RANGE);
+    
+    buckets[0] = cell_bit(x, y);
+    for (int d = 0; d <= budget; d++) {
+        Bitboard frontier = buckets[d];
+        while (frontier) {
+            int cell = bb_pop(&frontier);
+            int cx = cell % MAX_GRID_WIDTH, cy = cell / MAX_GRID_WIDTH;
+            if (d > 0) {
+                if (settled & cell_bit(cx, cy)) continue;   // Reached cheaper already
+                settled |= cell_bit(cx, cy);
+                reached |= cell_bit(cx, cy);
+            }
+            for (int k = 0; k < 4; k++) {
+                int nx = cx + step_x[k], ny = cy + step_y[k];
+                if (!is_valid_position(nx, ny) || ((closed | settled) & cell_bit(nx, ny))) continue;
+                int nd = d + terrain_info[bf->terrain[ny][nx]].move_cost;
+                if (nd <= budget) buckets[nd] |= cell_bit(nx, ny);
+            }
+        }
+    }
+    return reached;
+}
+
+// Cells a unit at (x, y) can move to this turn. Units on the board answer
+// from their cached reachable set.
+Bitboard move_targets(const Battlefield *bf, int x, int y) {
+    UnitHandle h = bf->cells[y][x].handle;
+    if (h) return bf->reach[HANDLE_SLOT(h)];
+    return reachable_cells(bf, x, y, MOVE_RANGE);
+}
+
+int unit_range(const UNIT *unit) {
+    if (!unit->item1) return 0;
+    int range = unit->item1->range;
+    if (unit->item2 && unit->item2->range > range) range = unit->item2->range;
+    return range;
+}
+
+// Whether a shot from (x1, y1) reaches (x2, y2) without crossing a unit or a
+// wall. Stops at the first blocked cell of a ray.
+bool has_line_of_sight(const Battlefield *bf, int x1, int y1, int x2, int y2) {
+    int dx = x2 - x1, dy = y2 - y1;
+    if (abs(dx) + abs(dy) > MAX_ATTACK_RANGE) return false;
+    
+    const LosRay *ray = &los_rays[dy + MAX_ATTACK_RANGE][dx + MAX_ATTACK_RANGE];
+    Bitboard blockers = bf->occupied[0] | bf->occupied[1] | bf->opaque;
+    for (int side = 0; side < (ray->tie ? 2 : 1); side++) {
+        int i = 0;
+        while (i < ray->count && !(blockers & cell_bit(x1 + ray->dx[side][i], y1 + ray->dy[side][i]))) i++;
+        if (i == ray->count) return true;
+    }
+    return false;
+}
+
+// Cells within `range` of (x, y) that a shot from there can reach
+Bitboard line_of_sight_cells(const Battlefield *bf, int x, int y, int range) {
+    Bitboard cells = range_mask(x, y, range) & ~cell_bit(x, y);
+    Bitboard open = 0;
+    while (cells) {
+        int cell = bb_pop(&cells);
+        int tx = cell % MAX_GRID_WIDTH, ty = cell / MAX_GRID_WIDTH;
+        if (has_line_of_sight(bf, x, y, tx, ty)) open |= cell_bit(tx, ty);
+    }
+    return open;
+}
+
+// Enemy cells the unit standing on (x, y) can attack: in range, in line of
+// sight and, under fog of war, seen by its team
+Bitboard attack_targets(const Battlefield *bf, const UNIT *unit, int x, int y) {
+    int team = team_at(bf, x, y);
+    Bitboard enemies = enemy_cells(bf, team);
+    if (team) enemies &= team_sight(bf, team);
+    Bitboard targets = range_mask(x, y, unit_range(unit)) & enemies;
+    
+    // Only the few enemies in range need their rays walked
+    Bitboard open = 0;
+    while (targets) {
+        int cell = bb_pop(&targets);
+        int tx = cell % MAX_GRID_WIDTH, ty = cell / MAX_GRID_WIDTH;
+        if (has_line_of_sight(bf, x, y, tx, ty)) open |= cell_bit(tx, ty);
+    }
+    return open;
+}
+
+bool closest_attack_target(const Battlefield *bf, const UNIT *unit, int x, int y, Position *target) {
+    Bitboard targets = attack_targets(bf, unit, x, y);
+    int min_dist = MAX_GRID_WIDTH + MAX_GRID_HEIGHT;
+    bool found = false;
+    while (targets) {
+        int cell = bb_pop(&targets);
+        int tx = cell % MAX_GRID_WIDTH, ty = cell / MAX_GRID_WIDTH;
+        int dist = manhattan_distance(x, y, tx, ty);
+        if (dist < min_dist) {
+            min_dist = dist;
+            *target = (Position){tx, ty};
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Frees every slot. Generations survive, so handles from before stay stale.
+static void reset_slots(Battlefield *bf) {
+    bf->free_count = 0;
+    for (int i = UNIT_SLOTS - 1; i >= 0; i--) {
+        UnitSlot *slot = &bf->slots[i];
+        if (slot->unit) {
+            slot->unit = NULL;
+            slot->generation = (slot->generation + 1) & 0xFFFFFF;
+        }
+        if (slot->generation == 0) slot->generation = 1;  // Keeps handles nonzero
+        bf->free_slots[bf->free_count++] = i;
+    }
+    effects_reset(&bf->effects);
+    initiative_reset(&bf->initiative);
+}
+
 void init_battlefield(Battlefield *bf) {
     memset(bf, 0, sizeof(Battlefield));
+    density_init(&bf->density, MAX_GRID_WIDTH, MAX_GRID_HEIGHT);
     bf->unit_counts[0] = 0;
     bf->unit_counts[1] = 0;
+    reset_slots(bf);
     bf->cursor_pos.x = 0;
     bf->cursor_pos.y = 0;
     bf->has_selection = false;
@@ -26,127 +237,290 @@ bool is_valid_position(int x, int y) {
     return x >= 0 && x < MAX_GRID_WIDTH && y >= 0 && y < MAX_GRID_HEIGHT;
 }
 
-void place_unit(Battlefield *bf, UNIT *unit, int team, int x, int y) {
-    if (!is_valid_position(x, y)) return;
-    
-    int idx = bf->unit_counts[team-1];
-    if (idx >= 5) return;
-    
-    bf->cells[y][x].unit = unit;
-    bf->cells[y][x].team = team;
-    bf->positions[team-1][idx].x = x;
-    bf->positions[team-1][idx].y = y;
-    bf->unit_counts[team-1]++;
+static void refresh_reach(Battlefield *bf, int idx) {
+    const UnitSlot *slot = &bf->slots[idx];
+    bf->reach[idx] = slot->unit ? reachable_cells(bf, slot->pos.x, slot->pos.y, MOVE_RANGE) : 0;
 }
 
-void remove_unit(Battlefield *bf, int x, int y) {
-    if (!is_valid_position(x, y)) return;
-    
-    int team = bf->cells[y][x].team;
-    if (team == 0) return;
-    
-    // Find and remove position
-    for (int i = 0; i < bf->unit_counts[team-1]; i++) {
-        if (bf->positions[team-1][i].x == x && bf->positions[team-1][i].y == y) {
-            // Shift remaining positions
-            for (int j = i; j < bf->unit_counts[team-1] - 1; j++) {
-                bf->positions[team-1][j] = bf->positions[team-1][j+1];
-            }
-            break;
+// Brings the cached reachable sets and the fog in line after the unit in
+// slot idx was placed, moved or removed. `changed` holds the cells whose
+// occupancy changed; only units within MOVE_RANGE of them search again.
+static void board_changed(Battlefield *bf, int idx, Bitboard changed) {
+    refresh_reach(bf, idx);
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        const UnitSlot *slot = &bf->slots[s];
+        if (s == idx || !slot->unit) continue;
+        if (range_mask(slot->pos.x, slot->pos.y, MOVE_RANGE) & changed) refresh_reach(bf, s);
+    }
+    fog_update(bf, idx, changed);
+}
+
+// Replaces the terrain (row-major Terrain values) and redoes everything
+// that depends on it
+void set_terrain(Battlefield *bf, const uint8_t *cells) {
+    bf->impassable = bf->opaque = 0;
+    for (int y = 0; y < MAX_GRID_HEIGHT; y++) {
+        for (int x = 0; x < MAX_GRID_WIDTH; x++) {
+            const TerrainInfo *info = &terrain_info[cells[y * MAX_GRID_WIDTH + x]];
+            bf->terrain[y][x] = cells[y * MAX_GRID_WIDTH + x];
+            if (info->move_cost == 0) bf->impassable |= cell_bit(x, y);
+            if (info->blocks_sight) bf->opaque |= cell_bit(x, y);
         }
     }
+    for (int s = 0; s < UNIT_SLOTS; s++) refresh_reach(bf, s);
+    fog_enable(bf, bf->fog.enabled);
+}
+
+UnitHandle place_unit(Battlefield *bf, UNIT *unit, int team, int x, int y) {
+    if (!is_valid_position(x, y) || bf->cells[y][x].handle) return NO_UNIT;
+    if (bf->unit_counts[team-1] >= MAX_ARMY || bf->free_count == 0) return NO_UNIT;
+    
+    int idx = bf->free_slots[--bf->free_count];
+    UnitSlot *slot = &bf->slots[idx];
+    slot->unit = unit;
+    slot->pos = (Position){x, y};
+    slot->team = team;
+    slot->index = bf->unit_counts[team-1]++;
+    
+    UnitHandle h = (slot->generation << 8) | (UnitHandle)idx;
+    bf->roster[team-1][slot->index] = h;
+    bf->cells[y][x].handle = h;
+    bf->occupied[team-1] |= cell_bit(x, y);
+    density_add(&bf->density, team, x, y, 1, unit->hp);
+    initiative_add(bf, idx);
+    board_changed(bf, idx, cell_bit(x, y));
+    return h;
+}
+
+// Empties the board but keeps windows, cursor and layout intact
+void clear_units(Battlefield *bf) {
+    memset(bf->cells, 0, sizeof(bf->cells));
+    bf->occupied[0] = bf->occupied[1] = 0;
+    density_init(&bf->density, MAX_GRID_WIDTH, MAX_GRID_HEIGHT);
+    bf->unit_counts[0] = 0;
+    bf->unit_counts[1] = 0;
+    reset_slots(bf);
+    memset(bf->reach, 0, sizeof(bf->reach));
+    fog_enable(bf, bf->fog.enabled);
+}
+
+// Takes the unit off the grid and frees its slot; the roster is the caller's job
+static void free_slot(Battlefield *bf, int idx) {
+    UnitSlot *slot = &bf->slots[idx];
+    bf->cells[slot->pos.y][slot->pos.x].handle = NO_UNIT;
+    bf->occupied[slot->team - 1] &= ~cell_bit(slot->pos.x, slot->pos.y);
+    density_add(&bf->density, slot->team, slot->pos.x, slot->pos.y, -1, -slot->unit->hp);
+    slot->unit = NULL;
+    slot->generation = (slot->generation + 1) & 0xFFFFFF;
+    if (slot->generation == 0) slot->generation = 1;
+    bf->free_slots[bf->free_count++] = idx;
+    clear_effects(bf, idx);
+    initiative_remove(bf, idx);
+    board_changed(bf, idx, cell_bit(slot->pos.x, slot->pos.y));
+}
+
+// Swap-removes the unit from its roster and frees the slot
+static void release_slot(Battlefield *bf, int idx) {
+    UnitSlot *slot = &bf->slots[idx];
+    int t = slot->team - 1;
+    
+    UnitHandle moved = bf->roster[t][--bf->unit_counts[t]];
+    bf->roster[t][slot->index] = moved;
+    bf->slots[HANDLE_SLOT(moved)].index = slot->index;
+    free_slot(bf, idx);
+}
+
+void remove_unit(Battlefield *bf, int x, int y) {
+    if (!is_valid_position(x, y)) return;
     
-    bf->cells[y][x].unit = NULL;
-    bf->cells[y][x].team = 0;
-    bf->unit_counts[team-1]--;
+    UnitHandle h = bf->cells[y][x].handle;
+    if (h) release_slot(bf, HANDLE_SLOT(h));
+}
+
+// Takes hp off the unit at (x, y). All damage to units on the board goes
+// through here so the density pyramid stays in step.
+void damage_unit(Battlefield *bf, int x, int y, int damage) {
+    const UnitSlot *slot = slot_at(bf, x, y);
+    if (!slot) return;
+    slot->unit->hp -= damage;
+    density_add(&bf->density, slot->team, x, y, 0, -damage);
+}
+
+// Looks a handle up, NULL once its unit has left the board
+const UnitSlot *unit_slot(const Battlefield *bf, UnitHandle h) {
+    if (h == NO_UNIT || HANDLE_SLOT(h) >= UNIT_SLOTS) return NULL;
+    const UnitSlot *slot = &bf->slots[HANDLE_SLOT(h)];
+    if (!slot->unit || slot->generation != HANDLE_GENERATION(h)) return NULL;
+    return slot;
 }
 
 bool check_window_size(int height, int width) {
     return height >= MIN_WINDOW_HEIGHT && width >= MIN_WINDOW_WIDTH;
 }
 
+static int clamp_int(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
 void calculate_grid_dimensions(Battlefield *bf, int parent_height, int parent_width) {
-    // Calculate available space
-    int available_width = parent_width - MIN_STATUS_WIDTH - 4;  // Leave space for borders
+    // Calculate available space, left of the widest side panel
+    int side_width = MIN_UNIT_LIST_WIDTH > MIN_STATUS_WIDTH ? MIN_UNIT_LIST_WIDTH : MIN_STATUS_WIDTH;
+    int available_width = parent_width - side_width - 4;  // Leave space for borders
     int available_height = parent_height - MIN_MESSAGE_HEIGHT - MIN_HINTS_HEIGHT - 4;
     
-    // Calculate cell size
-    bf->grid_dims.cell_width = 6;  // Minimum width for unit names
-    bf->grid_dims.cell_height = 3; // Minimum height for readability
-    
-    // Calculate grid size
-    bf->grid_dims.width = MAX_GRID_WIDTH;
-    bf->grid_dims.height = MAX_GRID_HEIGHT;
+    // Calculate cell size; small terminals keep the minimum and clip
+    bf->grid_dims.cell_width = clamp_int(available_width / MAX_GRID_WIDTH,
+                                         MIN_CELL_WIDTH, MAX_CELL_WIDTH);
+    bf->grid_dims.cell_height = clamp_int(available_height / MAX_GRID_HEIGHT,
+                                          MIN_CELL_HEIGHT, MAX_CELL_HEIGHT);
     
     // Calculate starting position
     bf->grid_dims.start_x = 2;
     bf->grid_dims.start_y = 2;
+    
+    // Calculate how many whole cells fit between the corner, the side
+    // panels and the hints, keeping a column and a row free for the scroll
+    // arrows; the rest of the board is reached by scrolling
+    PanelLayout layout;
+    calculate_panel_layout(&layout, parent_height, parent_width);
+    int side_x = layout.minimap.x < layout.unit_list.x ? layout.minimap.x : layout.unit_list.x;
+    int board_width = side_x - MAIN_WIN_X - bf->grid_dims.start_x - 1;
+    int board_height = layout.hints.y - MAIN_WIN_Y - bf->grid_dims.start_y - 1;
+    bf->grid_dims.width = clamp_int(board_width / bf->grid_dims.cell_width, 1, MAX_GRID_WIDTH);
+    bf->grid_dims.height = clamp_int(board_height / bf->grid_dims.cell_height, 1, MAX_GRID_HEIGHT);
+    
+    // A bigger window may show past the end of the board; pull the view back
+    bf->grid_dims.view_x = clamp_int(bf->grid_dims.view_x, 0, MAX_GRID_WIDTH - bf->grid_dims.width);
+    bf->grid_dims.view_y = clamp_int(bf->grid_dims.view_y, 0, MAX_GRID_HEIGHT - bf->grid_dims.height);
+    viewport_follow(bf, bf->cursor_pos.x, bf->cursor_pos.y);
 }
 
-void create_status_windows(Battlefield *bf, int parent_height, int parent_width) {
-    // Calculate dimensions based on window size
-    calculate_grid_dimensions(bf, parent_height, parent_width);
-    
+// Scrolls the view as little as possible to bring cell (x, y) into it
+void viewport_follow(Battlefield *bf, int x, int y) {
+    GridDimensions *dims = &bf->grid_dims;
+    if (x < dims->view_x) dims->view_x = x;
+    else if (x >= dims->view_x + dims->width) dims->view_x = x - dims->width + 1;
+    if (y < dims->view_y) dims->view_y = y;
+    else if (y >= dims->view_y + dims->height) dims->view_y = y - dims->height + 1;
+}
+
+void calculate_panel_layout(PanelLayout *layout, int parent_height, int parent_width) {
     int status_width = MIN_STATUS_WIDTH;
     int status_height = MIN_STATUS_HEIGHT;
     int unit_list_width = MIN_UNIT_LIST_WIDTH;
-    int unit_list_height = parent_height - status_height - MIN_HINTS_HEIGHT - 4;
+    int hints_y = parent_height - MIN_HINTS_HEIGHT - MIN_MESSAGE_HEIGHT - 1;
+    
+    // Status window on the right side
+    layout->status = (Rect){1, parent_width - status_width - 1, status_height, status_width};
     
-    // Create status window on the right side
-    bf->status_win = newwin(status_height, status_width, 
-                           1, parent_width - status_width - 1);
-    box(bf->status_win, 0, 0);
+    // Minimap just left of it
+    layout->minimap = (Rect){1, layout->status.x - MINIMAP_WIDTH - 1, status_height, MINIMAP_WIDTH};
     
-    // Create unit list window below status window
-    bf->unit_list_win = newwin(unit_list_height, unit_list_width,
-                              status_height + 2, parent_width - unit_list_width - 1);
-    box(bf->unit_list_win, 0, 0);
+    // Unit list window below status window, ending where the hints begin
+    layout->unit_list = (Rect){status_height + 2, parent_width - unit_list_width - 1,
+                               hints_y - status_height - 2, unit_list_width};
     
-    // Create hints window at the bottom
-    bf->hints_win = newwin(MIN_HINTS_HEIGHT, parent_width - 2,
-                          parent_height - MIN_HINTS_HEIGHT - MIN_MESSAGE_HEIGHT - 1, 1);
-    box(bf->hints_win, 0, 0);
+    // Hints window at the bottom
+    layout->hints = (Rect){hints_y, 1, MIN_HINTS_HEIGHT, parent_width - 2};
+    
+    // Message window at the bottom
+    layout->message = (Rect){parent_height - MIN_MESSAGE_HEIGHT - 1, 1,
+                             MIN_MESSAGE_HEIGHT, parent_width - 2};
+}
+
+static WINDOW *new_panel_window(const Rect *r) {
+    WINDOW *win = newwin(r->height, r->width, r->y, r->x);
+    box(win, 0, 0);
+    popup_attach(win);  // Menus may pop up over it
+    return win;
+}
+
+static void delete_panel_window(WINDOW **win) {
+    if (*win) {
+        popup_detach(*win);
+        delwin(*win);
+        *win = NULL;
+    }
+}
+
+void create_status_windows(Battlefield *bf, int parent_height, int parent_width) {
+    // Calculate dimensions based on window size
+    calculate_grid_dimensions(bf, parent_height, parent_width);
+    calculate_panel_layout(&bf->layout, parent_height, parent_width);
     
-    // Create message window at the bottom
-    bf->message_win = newwin(MIN_MESSAGE_HEIGHT, parent_width - 2, 
-                            parent_height - MIN_MESSAGE_HEIGHT - 1, 1);
-    box(bf->message_win, 0, 0);
+    bf->status_win = new_panel_window(&bf->layout.status);
+    bf->unit_list_win = new_panel_window(&bf->layout.unit_list);
+    bf->hints_win = new_panel_window(&bf->layout.hints);
+    bf->message_win = new_panel_window(&bf->layout.message);
+    bf->minimap_win = new_panel_window(&bf->layout.minimap);
     
     // Enable scrolling for message window
     scrollok(bf->message_win, TRUE);
 }
 
+// Moves and resizes a panel in place. The border is wiped first so the old
+// frame doesn't stay behind inside a larger panel; the contents are kept.
+static void place_panel_window(WINDOW *win, const Rect *r) {
+    wborder(win, ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ');
+    // Moving first can fail when the old size doesn't fit at the new spot
+    if (mvwin(win, r->y, r->x) == ERR) {
+        wresize(win, r->height, r->width);
+        mvwin(win, r->y, r->x);
+    } else {
+        wresize(win, r->height, r->width);
+    }
+    box(win, 0, 0);
+}
+
+// Fits the panels to the main window's current size without recreating
+// them, so the popup pool and the message panel keep their state
 void resize_windows(Battlefield *bf, WINDOW *main_win) {
     int parent_height, parent_width;
     getmaxyx(main_win, parent_height, parent_width);
     
-    // Destroy existing windows
-    destroy_status_windows(bf);
+    calculate_grid_dimensions(bf, parent_height, parent_width);
+    calculate_panel_layout(&bf->layout, parent_height, parent_width);
+    
+    place_panel_window(bf->status_win, &bf->layout.status);
+    place_panel_window(bf->unit_list_win, &bf->layout.unit_list);
+    place_panel_window(bf->hints_win, &bf->layout.hints);
+    place_panel_window(bf->message_win, &bf->layout.message);
+    place_panel_window(bf->minimap_win, &bf->layout.minimap);
     
-    // Recreate windows with new dimensions
-    create_status_windows(bf, parent_height, parent_width);
+    // Keep the unit list scroll position inside the resized panel
+    unit_list_scroll(bf, 0, bf->layout.unit_list.height - 2);
 }
 
 void destroy_status_windows(Battlefield *bf) {
-    if (bf->status_win) {
-        delwin(bf->status_win);
-        bf->status_win = NULL;
-    }
-    if (bf->message_win) {
-        delwin(bf->message_win);
-        bf->message_win = NULL;
-    }
-    if (bf->unit_list_win) {
-        delwin(bf->unit_list_win);
-        bf->unit_list_win = NULL;
-    }
-    if (bf->hints_win) {
-        delwin(bf->hints_win);
-        bf->hints_win = NULL;
+    delete_panel_window(&bf->status_win);
+    delete_panel_window(&bf->message_win);
+    delete_panel_window(&bf->unit_list_win);
+    delete_panel_window(&bf->hints_win);
+    delete_panel_window(&bf->minimap_win);
+}
+
+void invalidate_display(Battlefield *bf) {
+    // Popups drawn by ncurses leave the framebuffer out of sync with the terminal
+    if (bf->ansi) fb_invalidate(&bf->ansi->fb);
+}
+
+// Animation delay; recordings only move their clock forward
+void battle_pause(Battlefield *bf, long usec) {
+    if (bf->recorder) {
+        cast_advance(bf->recorder, usec);
+    } else {
+        usleep(usec);
     }
 }
 
 void update_status_panel(Battlefield *bf, const UNIT *selected_unit, const Position *cursor_pos) {
+    TRACE_SCOPE("update_status_panel");
+    if (bf->ansi) {
+        bf->ansi->selected = selected_unit;
+        ansi_render_frame(bf);
+        return;
+    }
+    
     WINDOW *win = bf->status_win;
     werase(win);
     box(win, 0, 0);
@@ -185,37 +559,106 @@ void update_status_panel(Battlefield *bf, const UNIT *selected_unit, const Posit
     }
     
     if (cursor_pos) {
-        mvwprintw(win, 9, 2, "Position: (%d,%d)", cursor_pos->x, cursor_pos->y);
+        mvwprintw(win, 9, 2, "Position: (%d,%d) %s", cursor_pos->x, cursor_pos->y,
+                  terrain_info[bf->terrain[cursor_pos->y][cursor_pos->x]].name);
         
         // Show unit under cursor if any
-        GridCell *cell = &bf->cells[cursor_pos->y][cursor_pos->x];
-        if (cell->unit) {
-            UNIT *unit = cell->unit;
+        const UnitSlot *slot = slot_at(bf, cursor_pos->x, cursor_pos->y);
+        if (slot && !fog_hides(bf, cursor_pos->x, cursor_pos->y)) {
+            UNIT *unit = slot->unit;
             mvwprintw(win, 10, 2, "Unit here: %s", unit->name);
-            mvwprintw(win, 11, 2, "Team: %d  HP: %d", cell->team, unit->hp);
+            mvwprintw(win, 11, 2, "Team: %d  HP: %d", slot->team, unit->hp);
         }
     }
     
     wrefresh(win);
 }
 
+// Adds a message to the combat log and shows it. Only the newest one is
+// formatted, when it is drawn; the rest wait in the log until scrolled to.
 void display_combat_message(Battlefield *bf, const char *format, ...) {
     va_list args;
     va_start(args, format);
+    char message[256];
+    if (bf->log) {
+        combat_log_add(bf->log, format, args);
+    } else {
+        // Nowhere to keep it, so it is shown now or never
+        vsnprintf(message, sizeof(message), format, args);
+    }
+    va_end(args);
+    
+    if (bf->ansi) {
+        ansi_render_frame(bf);
+        return;
+    }
     
     WINDOW *win = bf->message_win;
     wmove(win, 1, 1);
     wclrtoeol(win);
     
     // Print the message
-    wmove(win, 1, 2);
-    vw_printw(win, format, args);
+    if (bf->log) combat_log_format(bf->log, 0, message, sizeof(message));
+    mvwaddnstr(win, 1, 2, message, getmaxx(win) - 3);
     
+    box(win, 0, 0);
     wrefresh(win);
-    va_end(args);
+}
+
+// Scrollable view of the combat log, newest at the bottom, until a key
+// other than the scrolling ones
+void browse_combat_log(Battlefield *bf) {
+    int height = LINES - 4, width = COLS - 8;
+    if (!bf->log) return;
+    WINDOW *win = popup_open(POPUP_COMBAT_LOG, height, width, 2, 4);
+    if (!win) return;
+    
+    int rows = height - 2;
+    int size = combat_log_size(bf->log);
+    int last = size > rows ? size - rows : 0;  // Furthest the view can go back
+    int back = 0;                              // Messages below the view
+    char line[256];
+    int ch;
+    do {
+        werase(win);
+        box(win, 0, 0);
+        mvwprintw(win, 0, 2, " Combat Log: last %d of %u messages ", size, bf->log->count);
+        
+        // Only the rows in view are formatted
+        for (int row = 0; row < rows; row++) {
+            if (combat_log_format(bf->log, back + rows - 1 - row, line, sizeof(line))) {
+                mvwaddnstr(win, 1 + row, 2, line, width - 4);
+            }
+        }
+        mvwprintw(win, height - 1, 2, " Up/Down PgUp/PgDn Home/End: Scroll | Any other key: Close ");
+        wrefresh(win);
+        
+        ch = wgetch(win);
+        switch (ch) {
+            case KEY_UP:     back++; break;
+            case KEY_DOWN:   back--; break;
+            case KEY_PPAGE:  back += rows; break;
+            case KEY_NPAGE:  back -= rows; break;
+            case KEY_HOME:   back = last; break;
+            case KEY_END:    back = 0; break;
+            case KEY_RESIZE: ungetch(ch); ch = ERR; break;  // The game loop lays out again
+            default:         ch = ERR; break;
+        }
+        if (back > last) back = last;
+        if (back < 0) back = 0;
+    } while (ch != ERR);
+    
+    popup_close(POPUP_COMBAT_LOG);
+    invalidate_display(bf);
 }
 
 void display_controls_hint(Battlefield *bf, const char *hint) {
+    if (bf->ansi) {
+        snprintf(bf->ansi->controls, sizeof(bf->ansi->controls), "%s", hint);
+        ansi_render_frame(bf);
+        return;
+    }
+    
     WINDOW *win = bf->message_win;
     mvwprintw(win, 2, 2, "Controls: %s", hint);
     wrefresh(win);
@@ -224,20 +667,8 @@ void display_controls_hint(Battlefield *bf, const char *hint) {
 bool is_valid_attack_target(const Battlefield *bf, const UNIT *attacker, int x1, int y1, int x2, int y2) {
     if (!is_valid_position(x2, y2)) return false;
     
-    // Check if target position has an enemy unit
-    const GridCell *target_cell = &bf->cells[y2][x2];
-    if (!target_cell->unit || target_cell->team == bf->cells[y1][x1].team) {
-        return false;
-    }
-    
-    // Check range using Manhattan distance
-    int dist = manhattan_distance(x1, y1, x2, y2);
-    int range = attacker->item1->range;
-    if (attacker->item2 && attacker->item2->range > range) {
-        range = attacker->item2->range;
-    }
-    
-    return dist <= range;
+    // An enemy unit within range
+    return (attack_targets(bf, attacker, x1, y1) & cell_bit(x2, y2)) != 0;
 }
 
 int calculate_damage(const UNIT *attacker, const UNIT *defender) {
@@ -258,34 +689,62 @@ int calculate_damage(const UNIT *attacker, const UNIT *defender) {
     return damage > 0 ? damage : 1;
 }
 
+// Draws the border of board cell (x, y) if it is in view, with the corners
+// for a full frame or plain lines for a range highlight
+static void frame_cell(WINDOW *win, const GridDimensions *dims, int x, int y, bool corners) {
+    int px, py;
+    if (!grid_cell_origin(dims, x, y, &px, &py)) return;
+    
+    mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
+    mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
+    mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
+    mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
+    
+    if (corners) {
+        mvwaddch(win, py, px, ACS_ULCORNER);
+        mvwaddch(win, py, px + dims->cell_width - 1, ACS_URCORNER);
+        mvwaddch(win, py + dims->cell_height - 1, px, ACS_LLCORNER);
+        mvwaddch(win, py + dims->cell_height - 1, px + dims->cell_width - 1, ACS_LRCORNER);
+    }
+}
+
 void draw_battlefield(WINDOW *win, const Battlefield *bf) {
+    TRACE_SCOPE("draw_battlefield");
     werase(win);
     
     const GridDimensions *dims = &bf->grid_dims;
+    Bitboard view = fog_view(bf);
     
-    // Draw grid
-    for (int y = 0; y < dims->height; y++) {
-        for (int x = 0; x < dims->width; x++) {
-            int px = dims->start_x + x * dims->cell_width;
-            int py = dims->start_y + y * dims->cell_height;
-            
-            // Draw cell border
-            mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
-            mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
-            mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
-            mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
+    // Draw the cells in view; the cost follows the window, not the board
+    for (int y = dims->view_y; y < dims->view_y + dims->height; y++) {
+        for (int x = dims->view_x; x < dims->view_x + dims->width; x++) {
+            int px = dims->start_x + (x - dims->view_x) * dims->cell_width;
+            int py = dims->start_y + (y - dims->view_y) * dims->cell_height;
             
-            // Draw corners
-            mvwaddch(win, py, px, ACS_ULCORNER);
-            mvwaddch(win, py, px + dims->cell_width - 1, ACS_URCORNER);
-            mvwaddch(win, py + dims->cell_height - 1, px, ACS_LLCORNER);
-            mvwaddch(win, py + dims->cell_height - 1, px + dims->cell_width - 1, ACS_LRCORNER);
+            // Non-plain terrain colors the frame and fills empty cells with
+            // its glyph. Cells out of sight are dimmed, plain ones shaded, and
+            // whatever stands there stays hidden.
+            const TerrainInfo *ground = &terrain_info[bf->terrain[y][x]];
+            bool seen = (view & cell_bit(x, y)) != 0;
+            attr_t attrs = COLOR_PAIR(ground->color) | (seen ? 0 : A_DIM);
+            wattron(win, attrs);
+            frame_cell(win, dims, x, y, true);
+            if (!seen || (bf->terrain[y][x] != TERRAIN_PLAIN && !bf->cells[y][x].handle)) {
+                chtype fill = bf->terrain[y][x] == TERRAIN_PLAIN ? ACS_CKBOARD : (chtype)ground->glyph;
+                for (int row = 1; row < dims->cell_height - 1; row++) {
+                    mvwhline(win, py + row, px + 1, fill, dims->cell_width - 2);
+                }
+            }
+            wattroff(win, attrs);
+            if (!seen) continue;
             
             // Draw unit if present
-            if (bf->cells[y][x].unit) {
-                UNIT *u = bf->cells[y][x].unit;
-                wattron(win, COLOR_PAIR(bf->cells[y][x].team));
-                mvwprintw(win, py + 1, px + 1, "%-4.4s", u->name);
+            const UnitSlot *slot = slot_at(bf, x, y);
+            if (slot) {
+                UNIT *u = slot->unit;
+                wattron(win, COLOR_PAIR(slot->team));
+                int name_width = dims->cell_width - 2;
+                mvwprintw(win, py + 1, px + 1, "%-*.*s", name_width, name_width, u->name);
                 
                 // Show HP bar
                 int hp_width = (u->hp * (dims->cell_width - 2)) / 100;
@@ -294,14 +753,22 @@ void draw_battlefield(WINDOW *win, const Battlefield *bf) {
                     mvwaddch(win, py + 2, px + 1 + i, ' ');
                 }
                 wattroff(win, A_REVERSE);
-                wattroff(win, COLOR_PAIR(bf->cells[y][x].team));
+                wattroff(win, COLOR_PAIR(slot->team));
             }
         }
     }
     
+    // Show that the board goes on past the edges of the view
+    int right = dims->start_x + dims->width * dims->cell_width;
+    int bottom = dims->start_y + dims->height * dims->cell_height;
+    if (dims->view_x > 0) mvwaddch(win, dims->start_y + 1, dims->start_x - 1, ACS_LARROW);
+    if (dims->view_x + dims->width < MAX_GRID_WIDTH) mvwaddch(win, dims->start_y + 1, right, ACS_RARROW);
+    if (dims->view_y > 0) mvwaddch(win, dims->start_y - 1, dims->start_x + 1, ACS_UARROW);
+    if (dims->view_y + dims->height < MAX_GRID_HEIGHT) mvwaddch(win, bottom, dims->start_x + 1, ACS_DARROW);
+    
     // Show movement range if a unit is selected
     if (bf->has_selection) {
-        UNIT *selected = bf->cells[bf->selected_pos.y][bf->selected_pos.x].unit;
+        UNIT *selected = unit_at(bf, bf->selected_pos.x, bf->selected_pos.y);
         if (selected) {
             if (bf->state == STATE_MOVE_UNIT) {
                 highlight_valid_moves(win, bf, bf->selected_pos.x, bf->selected_pos.y);
@@ -322,45 +789,311 @@ const char *get_item_summary(const ITEM *item) {
     return buffer;
 }
 
+static const char *sort_names[SORT_MODE_COUNT] = { "team", "hp", "distance" };
+
+const char *unit_list_sort_name(UnitSortMode mode) {
+    return mode < SORT_MODE_COUNT ? sort_names[mode] : "?";
+}
+
+static UnitListEntry *find_list_entry(UnitListView *view, const UNIT *unit, int hint) {
+    // Units are walked in the same order every sync, so the hint is usually right
+    if (hint < view->count && view->entries[hint].unit == unit) return &view->entries[hint];
+    for (int i = 0; i < view->count; i++) {
+        if (view->entries[i].unit == unit) return &view->entries[i];
+    }
+    return NULL;
+}
+
+static void remove_list_entry(UnitListView *view, int idx) {
+    int last = view->count - 1;
+    view->entries[idx] = view->entries[last];
+
+    // Drop idx from the order and renumber the entry that moved into its slot
+    int k = 0;
+    for (int i = 0; i < view->count; i++) {
+        if (view->order[i] == idx) continue;
+        view->order[k++] = view->order[i] == last ? idx : view->order[i];
+    }
+    view->count--;
+}
+
+static int list_sort_key(const Battlefield *bf, const UnitListEntry *e) {
+    switch (bf->unit_list.sort) {
+        case SORT_BY_HP:
+            return e->hp;
+        case SORT_BY_DISTANCE:
+            return manhattan_distance(e->pos.x, e->pos.y, bf->cursor_pos.x, bf->cursor_pos.y);
+        default:
+            return e->team;
+    }
+}
+
+// Brings the list in line with the board. Entries keep their formatted text
+// unless hp or position changed, and the order is repaired with an insertion
+// sort, which is linear when only a few keys moved since the last sync.
+void unit_list_sync(Battlefield *bf) {
+    UnitListView *view = &bf->unit_list;
+    for (int i = 0; i < view->count; i++) view->entries[i].seen = false;
+
+    int walk = 0;
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < bf->unit_counts[t]; i++, walk++) {
+            const UnitSlot *slot = roster_slot(bf, t, i);
+            Position pos = slot->pos;
+            const UNIT *unit = slot->unit;
+            if (!unit || fog_hides(bf, pos.x, pos.y)) continue;
+
+            UnitListEntry *e = find_list_entry(view, unit, walk);
+            if (!e) {
+                if (view->count == UNIT_LIST_MAX) continue;
+                view->order[view->count] = view->count;
+                e = &view->entries[view->count++];
+                memset(e, 0, sizeof(*e));
+                e->unit = unit;
+                e->dirty = true;
+            }
+            int effects = 0;
+            for (int type = 1; type < EFFECT_COUNT; type++) {
+                if (has_effect(bf, (int)(slot - bf->slots), type)) effects |= 1 << type;
+            }
+            if (e->hp != unit->hp || e->pos.x != pos.x || e->pos.y != pos.y || e->effects != effects) {
+                e->dirty = true;
+            }
+            e->team = t + 1;
+            e->pos = pos;
+            e->hp = unit->hp;
+            e->effects = effects;
+            e->line_count = unit->item2 ? 3 : 2;
+            e->seen = true;
+        }
+    }
+
+    // Units that left the board
+    for (int i = 0; i < view->count; ) {
+        if (view->entries[i].seen) i++;
+        else remove_list_entry(view, i);
+    }
+
+    for (int i = 0; i < view->count; i++) {
+        view->entries[i].sort_key = list_sort_key(bf, &view->entries[i]);
+    }
+    for (int i = 1; i < view->count; i++) {
+        int idx = view->order[i];
+        int key = view->entries[idx].sort_key;
+        int j = i - 1;
+        while (j >= 0 && view->entries[view->order[j]].sort_key > key) {
+            view->order[j + 1] = view->order[j];
+            j--;
+        }
+        view->order[j + 1] = idx;
+    }
+
+    // Row offsets; sorting by team keeps the "Army N:" headers
+    int row = 0, prev_team = 0;
+    for (int k = 0; k < view->count; k++) {
+        const UnitListEntry *e = &view->entries[view->order[k]];
+        if (view->sort == SORT_BY_TEAM && e->team != prev_team) {
+            if (prev_team) row++;   // Blank line between armies
+            row++;
+            prev_team = e->team;
+        }
+        view->row_start[k] = row;
+        row += e->line_count;
+    }
+    view->rows = row;
+}
+
+int unit_list_rows(const Battlefield *bf) {
+    return bf->unit_list.rows;
+}
+
+static void format_list_entry(UnitListEntry *e) {
+    const UNIT *u = e->unit;
+    snprintf(e->lines[0], UNIT_LIST_LINE, "%.*s [%d,%d] HP:%d%s%s%s",
+             UNIT_LIST_NAME, u->name, e->pos.x, e->pos.y, e->hp,
+             e->effects & (1 << EFFECT_FREEZE) ? " frozen" : "",
+             e->effects & (1 << EFFECT_BURN) ? " burning" : "",
+             e->effects & (1 << EFFECT_SHIELD) ? " shielded" : "");
+    const ITEM *items[2] = { u->item1, u->item2 };
+    for (int i = 0; i < 2; i++) {
+        const ITEM *it = items[i];
+        if (it) {
+            snprintf(e->lines[i + 1], UNIT_LIST_LINE, "%d:%.*s (A:%d,D:%d,R:%d)",
+                     i + 1, UNIT_LIST_NAME, it->name, it->att, it->def, it->range);
+        } else {
+            snprintf(e->lines[i + 1], UNIT_LIST_LINE, "%d:None", i + 1);
+        }
+    }
+    e->dirty = false;
+}
+
+// Describes one row of the list. Only the rows asked for get formatted.
+bool unit_list_row(Battlefield *bf, int row, UnitListRow *out) {
+    static const char *headers[2] = { "Army 1:", "Army 2:" };
+    UnitListView *view = &bf->unit_list;
+    if (row < 0 || row >= view->rows) return false;
+
+    // Last entry starting at or before row
+    int lo = 0, hi = view->count - 1, k = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (view->row_start[mid] <= row) {
+            k = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    out->header = false;
+    out->color = 0;
+    out->indent = 2;
+    if (k < 0 || row >= view->row_start[k] + view->entries[view->order[k]].line_count) {
+        // Between entries: an army header or the blank line before it
+        const UnitListEntry *next = &view->entries[view->order[k + 1]];
+        bool header = row == view->row_start[k + 1] - 1;
+        out->text = header ? headers[next->team - 1] : "";
+        out->color = header ? next->team : 0;
+        out->header = header;
+        return true;
+    }
+
+    UnitListEntry *e = &view->entries[view->order[k]];
+    if (e->dirty) format_list_entry(e);
+    int line = row - view->row_start[k];
+    out->text = e->lines[line];
+    if (line > 0) out->indent = 3;
+    // Mixed orders color the name so the armies stay apart
+    else if (view->sort != SORT_BY_TEAM) out->color = e->team;
+    return true;
+}
+
+void unit_list_scroll(Battlefield *bf, int delta, int visible) {
+    UnitListView *view = &bf->unit_list;
+    int max_scroll = view->rows - visible;
+    if (max_scroll < 0) max_scroll = 0;
+    view->scroll += delta;
+    if (view->scroll > max_scroll) view->scroll = max_scroll;
+    if (view->scroll < 0) view->scroll = 0;
+}
+
+void unit_list_cycle_sort(Battlefield *bf) {
+    bf->unit_list.sort = (bf->unit_list.sort + 1) % SORT_MODE_COUNT;
+    bf->unit_list.scroll = 0;
+}
+
 void update_unit_list(Battlefield *bf) {
+    TRACE_SCOPE("update_unit_list");
+    if (bf->ansi) {
+        ansi_render_frame(bf);
+        return;
+    }
+    
+    unit_list_sync(bf);
+    
     WINDOW *win = bf->unit_list_win;
+    int win_height, win_width;
+    getmaxyx(win, win_height, win_width);
+    int visible = win_height - 2;
+    unit_list_scroll(bf, 0, visible);
+    
     werase(win);
     box(win, 0, 0);
-    mvwprintw(win, 0, 2, " Unit List ");
-    
-    int y = 1;
-    
-    // Display Army 1
-    wattron(win, COLOR_PAIR(1));
-    mvwprintw(win, y++, 2, "Army 1:");
-    wattroff(win, COLOR_PAIR(1));
-    
-    for (int i = 0; i < bf->unit_counts[0]; i++) {
-        Position *pos = &bf->positions[0][i];
-        UNIT *unit = bf->cells[pos->y][pos->x].unit;
-        mvwprintw(win, y++, 2, "%s [%d,%d] HP:%d", 
-                  unit->name, pos->x, pos->y, unit->hp);
-        mvwprintw(win, y++, 3, "1:%s", get_item_summary(unit->item1));
-        if (unit->item2) {
-            mvwprintw(win, y++, 3, "2:%s", get_item_summary(unit->item2));
-        }
+    mvwprintw(win, 0, 2, " Unit List (%s) ", unit_list_sort_name(bf->unit_list.sort));
+    
+    // Only the rows that fit in the window are formatted and drawn
+    int scroll = bf->unit_list.scroll;
+    for (int i = 0; i < visible; i++) {
+        UnitListRow row;
+        if (!unit_list_row(bf, scroll + i, &row)) break;
+        if (row.color) wattron(win, COLOR_PAIR(row.color));
+        mvwprintw(win, 1 + i, row.indent, "%.*s", win_width - row.indent - 1, row.text);
+        if (row.color) wattroff(win, COLOR_PAIR(row.color));
     }
     
-    y++;
+    // Show that there is more above or below
+    if (scroll > 0) mvwaddch(win, 1, win_width - 1, ACS_UARROW);
+    if (scroll + visible < unit_list_rows(bf)) mvwaddch(win, visible, win_width - 1, ACS_DARROW);
     
-    // Display Army 2
-    wattron(win, COLOR_PAIR(2));
-    mvwprintw(win, y++, 2, "Army 2:");
-    wattroff(win, COLOR_PAIR(2));
+    wrefresh(win);
+}
+
+// Finest pyramid level whose pixels fit in the minimap panel
+int minimap_level(const Battlefield *bf) {
+    const Rect *r = &bf->layout.minimap;
+    return density_level_for(&bf->density, (r->width - 2) / 2, r->height - 2);
+}
+
+// Board cells under a minimap pixel
+static Bitboard minimap_block(int level, int mx, int my) {
+    int x0 = mx << level, y0 = my << level, size = 1 << level;
+    int x1 = MIN(x0 + size, MAX_GRID_WIDTH), y1 = MIN(y0 + size, MAX_GRID_HEIGHT);
+    Bitboard row = (((Bitboard)1 << (x1 - x0)) - 1) << x0;
+    Bitboard block = 0;
+    for (int y = y0; y < y1; y++) block |= row << (y * MAX_GRID_WIDTH);
+    return block;
+}
+
+void minimap_pixel(const Battlefield *bf, int level, int mx, int my, MinimapPixel *out) {
+    DensityCell cell = *density_cell(&bf->density, level, mx, my);
+    
+    // Under fog of war, take back the units the viewer can't see
+    Bitboard block = 0, hidden = 0;
+    if (bf->fog.enabled) {
+        block = minimap_block(level, mx, my);
+        hidden = block & (bf->occupied[0] | bf->occupied[1]) & ~fog_view(bf);
+    }
+    while (hidden) {
+        int c = bb_pop(&hidden);
+        const UnitSlot *slot = slot_at(bf, c % MAX_GRID_WIDTH, c / MAX_GRID_WIDTH);
+        cell.count[slot->team - 1]--;
+        cell.hp[slot->team - 1] -= slot->unit->hp;
+    }
+    int count = cell.count[0] + cell.count[1];
+    
+    out->glyph = count == 0 ? '.' : count == 1 ? 'o' : count <= 3 ? 'O' : '@';
+    if (bf->fog.enabled && !(block & fog_view(bf))) out->glyph = ' ';
+    out->color = cell.count[0] && cell.count[1] ? 3 : cell.count[0] ? 1 : cell.count[1] ? 2 : 0;
+    out->shade = 0;
+    if (count > 0) {
+        int avg_hp = (cell.hp[0] + cell.hp[1]) / count;
+        out->shade = avg_hp > 66 ? 1 : avg_hp > 33 ? 0 : -1;
+    }
     
-    for (int i = 0; i < bf->unit_counts[1]; i++) {
-        Position *pos = &bf->positions[1][i];
-        UNIT *unit = bf->cells[pos->y][pos->x].unit;
-        mvwprintw(win, y++, 2, "%s [%d,%d] HP:%d", 
-                  unit->name, pos->x, pos->y, unit->hp);
-        mvwprintw(win, y++, 3, "1:%s", get_item_summary(unit->item1));
-        if (unit->item2) {
-            mvwprintw(win, y++, 3, "2:%s", get_item_summary(unit->item2));
+    // Board cells under this pixel, against the cells in the main window
+    const GridDimensions *dims = &bf->grid_dims;
+    int x0 = mx << level, y0 = my << level, size = 1 << level;
+    out->in_view = x0 < dims->view_x + dims->width && x0 + size > dims->view_x &&
+                   y0 < dims->view_y + dims->height && y0 + size > dims->view_y;
+}
+
+// One pyramid lookup per pixel, however many units the board holds
+void update_minimap(Battlefield *bf) {
+    TRACE_SCOPE("update_minimap");
+    if (bf->ansi) {
+        ansi_render_frame(bf);
+        return;
+    }
+    
+    WINDOW *win = bf->minimap_win;
+    werase(win);
+    box(win, 0, 0);
+    
+    int level = minimap_level(bf);
+    mvwprintw(win, 0, 1, " Map 1:%d ", 1 << level);
+    
+    int rows = bf->density.height[level], cols = bf->density.width[level];
+    for (int my = 0; my < rows && my < bf->layout.minimap.height - 2; my++) {
+        for (int mx = 0; mx < cols && mx < (bf->layout.minimap.width - 2) / 2; mx++) {
+            MinimapPixel px;
+            minimap_pixel(bf, level, mx, my, &px);
+            attr_t attrs = COLOR_PAIR(px.color);
+            if (px.shade > 0) attrs |= A_BOLD;
+            if (px.shade < 0) attrs |= A_DIM;
+            if (px.in_view) attrs |= A_REVERSE;
+            wattron(win, attrs);
+            mvwprintw(win, 1 + my, 1 + mx * 2, "%c ", px.glyph);
+            wattroff(win, attrs);
         }
     }
     
@@ -368,40 +1101,16 @@ void update_unit_list(Battlefield *bf) {
 }
 
 void highlight_cursor(WINDOW *win, const Battlefield *bf) {
-    const GridDimensions *dims = &bf->grid_dims;
-    int px = dims->start_x + bf->cursor_pos.x * dims->cell_width;
-    int py = dims->start_y + bf->cursor_pos.y * dims->cell_height;
-    
     wattron(win, A_BOLD | COLOR_PAIR(3));
-    mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
-    mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
-    mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
-    mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
-    
-    mvwaddch(win, py, px, ACS_ULCORNER);
-    mvwaddch(win, py, px + dims->cell_width - 1, ACS_URCORNER);
-    mvwaddch(win, py + dims->cell_height - 1, px, ACS_LLCORNER);
-    mvwaddch(win, py + dims->cell_height - 1, px + dims->cell_width - 1, ACS_LRCORNER);
+    frame_cell(win, &bf->grid_dims, bf->cursor_pos.x, bf->cursor_pos.y, true);
     wattroff(win, A_BOLD | COLOR_PAIR(3));
 }
 
 void highlight_selected_unit(WINDOW *win, const Battlefield *bf) {
     if (!bf->has_selection) return;
     
-    const GridDimensions *dims = &bf->grid_dims;
-    int px = dims->start_x + bf->selected_pos.x * dims->cell_width;
-    int py = dims->start_y + bf->selected_pos.y * dims->cell_height;
-    
     wattron(win, A_BOLD | COLOR_PAIR(4));
-    mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
-    mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
-    mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
-    mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
-    
-    mvwaddch(win, py, px, ACS_ULCORNER);
-    mvwaddch(win, py, px + dims->cell_width - 1, ACS_URCORNER);
-    mvwaddch(win, py + dims->cell_height - 1, px, ACS_LLCORNER);
-    mvwaddch(win, py + dims->cell_height - 1, px + dims->cell_width - 1, ACS_LRCORNER);
+    frame_cell(win, &bf->grid_dims, bf->selected_pos.x, bf->selected_pos.y, true);
     wattroff(win, A_BOLD | COLOR_PAIR(4));
 }
 
@@ -412,9 +1121,9 @@ const char *get_state_hint(GameState state) {
         case STATE_POSITIONING:
             return "Position your units | Arrow keys: Move | Enter: Place/Pick up | Space: Done | Esc: Cancel";
         case STATE_SELECT_UNIT:
-            return "Select a unit to command | Arrow keys: Move cursor | Enter: Select unit | Esc: Cancel";
+            return "Select a unit to command | Arrow keys: Move cursor | Enter: Select | U/R: Undo/Redo | PgUp/PgDn/O: Unit list | L: Log";
         case STATE_MOVE_UNIT:
-            return "Choose where to move (2 squares max) | Arrow keys: Move | Enter: Confirm | Esc: Cancel";
+            return "Choose where to move (2 points, forest costs 2) | Arrow keys: Move | Enter: Confirm | Esc: Cancel";
         case STATE_SELECT_ACTION:
             return "Choose action | ↑↓: Select | Enter: Confirm | Esc: Cancel | Range shown in yellow";
         case STATE_SELECT_TARGET:
@@ -434,6 +1143,12 @@ void set_game_state(Battlefield *bf, GameState new_state) {
 }
 
 void update_hints(Battlefield *bf) {
+    TRACE_SCOPE("update_hints");
+    if (bf->ansi) {
+        ansi_render_frame(bf);
+        return;
+    }
+    
     WINDOW *win = bf->hints_win;
     werase(win);
     box(win, 0, 0);
@@ -454,6 +1169,17 @@ void update_hints(Battlefield *bf) {
 }
 
 void update_all_displays(WINDOW *win, Battlefield *bf, const UNIT *selected_unit) {
+    TRACE_SCOPE("update_all_displays");
+    // The view follows the cursor
+    viewport_follow(bf, bf->cursor_pos.x, bf->cursor_pos.y);
+    
+    // The framebuffer renderer draws everything in one frame and one write()
+    if (bf->ansi) {
+        bf->ansi->selected = selected_unit;
+        ansi_render_frame(bf);
+        return;
+    }
+    
     // Draw base battlefield
     draw_battlefield(win, bf);
     
@@ -464,6 +1190,7 @@ void update_all_displays(WINDOW *win, Battlefield *bf, const UNIT *selected_unit
     // Update all panels
     update_status_panel(bf, selected_unit, &bf->cursor_pos);
     update_unit_list(bf);
+    update_minimap(bf);
     update_hints(bf);
     
     // Refresh main window
@@ -471,22 +1198,22 @@ void update_all_displays(WINDOW *win, Battlefield *bf, const UNIT *selected_unit
 }
 
 void create_item_menu(ItemMenu *menu, int parent_height, int parent_width) {
-    menu->win = newwin(ITEM_MENU_HEIGHT, ITEM_MENU_WIDTH,
-                      (parent_height - ITEM_MENU_HEIGHT) / 2,
-                      (parent_width - ITEM_MENU_WIDTH) / 2);
+    menu->win = popup_open(POPUP_ITEM_MENU, ITEM_MENU_HEIGHT, ITEM_MENU_WIDTH,
+                           (parent_height - ITEM_MENU_HEIGHT) / 2,
+                           (parent_width - ITEM_MENU_WIDTH) / 2);
     menu->current_page = 0;
     menu->selected_item = 0;
     menu->available_items = items;
     menu->num_items = NUMBER_OF_ITEMS;
     menu->total_pages = (menu->num_items + ITEMS_PER_PAGE - 1) / ITEMS_PER_PAGE;
     
-    keypad(menu->win, TRUE);
     box(menu->win, 0, 0);
 }
 
+// The window goes back to the popup pool for the next unit
 void destroy_item_menu(ItemMenu *menu) {
     if (menu->win) {
-        delwin(menu->win);
+        popup_close(POPUP_ITEM_MENU);
         menu->win = NULL;
     }
 }
@@ -598,49 +1325,39 @@ const ITEM *show_item_selection(ItemMenu *menu, const char *title, int slots_ava
 
 bool is_valid_move(const Battlefield *bf, int from_x, int from_y, int to_x, int to_y) {
     if (!is_valid_position(to_x, to_y)) return false;
-    if (bf->cells[to_y][to_x].unit != NULL) return false;
-    
-    // Calculate Manhattan distance
-    int dist = manhattan_distance(from_x, from_y, to_x, to_y);
-    return dist <= 2; // Units can move up to 2 squares per turn
+    return (move_targets(bf, from_x, from_y) & cell_bit(to_x, to_y)) != 0;
 }
 
 bool move_unit(Battlefield *bf, int from_x, int from_y, int to_x, int to_y) {
     if (!is_valid_move(bf, from_x, from_y, to_x, to_y)) return false;
     
-    UNIT *unit = bf->cells[from_y][from_x].unit;
-    int team = bf->cells[from_y][from_x].team;
-    
-    // Update unit position in positions array
-    for (int i = 0; i < bf->unit_counts[team-1]; i++) {
-        if (bf->positions[team-1][i].x == from_x && 
-            bf->positions[team-1][i].y == from_y) {
-            bf->positions[team-1][i].x = to_x;
-            bf->positions[team-1][i].y = to_y;
-            break;
-        }
-    }
+    UnitHandle h = bf->cells[from_y][from_x].handle;
+    if (!h) return false;
     
-    // Move unit to new position
-    bf->cells[to_y][to_x].unit = unit;
-    bf->cells[to_y][to_x].team = team;
-    bf->cells[from_y][from_x].unit = NULL;
-    bf->cells[from_y][from_x].team = 0;
+    // The handle moves; the slot just learns its new position
+    UnitSlot *slot = &bf->slots[HANDLE_SLOT(h)];
+    slot->pos = (Position){to_x, to_y};
+    bf->cells[to_y][to_x].handle = h;
+    bf->cells[from_y][from_x].handle = NO_UNIT;
+    bf->occupied[slot->team-1] ^= cell_bit(from_x, from_y) | cell_bit(to_x, to_y);
+    density_add(&bf->density, slot->team, from_x, from_y, -1, -slot->unit->hp);
+    density_add(&bf->density, slot->team, to_x, to_y, 1, slot->unit->hp);
+    board_changed(bf, HANDLE_SLOT(h), cell_bit(from_x, from_y) | cell_bit(to_x, to_y));
     
     return true;
 }
 
 void create_action_menu(ActionMenu *menu, int parent_height, int parent_width) {
-    menu->win = newwin(8, 20, 
-                      parent_height/2 - 4,
-                      parent_width/2 - 10);
+    menu->win = popup_open(POPUP_ACTION_MENU, 8, 20,
+                           parent_height/2 - 4,
+                           parent_width/2 - 10);
     menu->selected_action = 0;
-    keypad(menu->win, TRUE);
 }
 
+// Hiding the popup repaints only the cells it covered
 void destroy_action_menu(ActionMenu *menu) {
     if (menu->win) {
-        delwin(menu->win);
+        popup_close(POPUP_ACTION_MENU);
         menu->win = NULL;
     }
 }
@@ -726,6 +1443,11 @@ ActionType show_action_menu(ActionMenu *menu, const UNIT *unit) {
                 
             case 27: // Escape
                 return -1;
+                
+            case KEY_RESIZE:
+                // Close and let the game loop lay the screen out again
+                ungetch(KEY_RESIZE);
+                return -1;
         }
     }
 }
@@ -737,162 +1459,227 @@ bool has_special_ability(const UNIT *unit) {
     return false;
 }
 
-void use_special_ability(Battlefield *bf, const UNIT *unit, int x, int y) {
-    // First, let's check if this unit has any items with area damage abilities
-    // (items with a radius > 0 can hit multiple targets!)
-    const ITEM *special_item = NULL;
-    if (unit->item1 && unit->item1->radius > 0) special_item = unit->item1;
-    else if (unit->item2 && unit->item2->radius > 0) special_item = unit->item2;
-    
-    // If we didn't find any items with area damage, we can't use a special ability
-    if (!special_item) return;
+const ITEM *special_item(const UNIT *unit) {
+    if (unit->item1 && unit->item1->radius > 0) return unit->item1;
+    if (unit->item2 && unit->item2->radius > 0) return unit->item2;
+    return NULL;
+}
+
+// Offsets of every cell a blast of each radius covers, minus the caster's own
+typedef struct {
+    int count;
+    signed char dx[BLAST_STENCIL_MAX];
+    signed char dy[BLAST_STENCIL_MAX];
+} BlastStencil;
+
+static BlastStencil blast_stencils[MAX_BLAST_RADIUS + 1];
+
+static void build_blast_stencils(void) {
+    for (int radius = 0; radius <= MAX_BLAST_RADIUS; radius++) {
+        BlastStencil *st = &blast_stencils[radius];
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                if (dx == 0 && dy == 0) continue;
+                st->dx[st->count] = (signed char)dx;
+                st->dy[st->count] = (signed char)dy;
+                st->count++;
+            }
+        }
+    }
+}
+
+static const BlastStencil *blast_stencil(int radius) {
+    return &blast_stencils[MIN(radius, MAX_BLAST_RADIUS)];
+}
+
+// Enemy cells a blast from (x, y) would catch, empty without a special item
+Bitboard blast_targets(const Battlefield *bf, const UNIT *unit, int x, int y) {
+    const ITEM *item = special_item(unit);
+    if (!item) return 0;
+    
+    const BlastStencil *st = blast_stencil(item->radius);
+    Bitboard enemies = enemy_cells(bf, team_at(bf, x, y));
+    Bitboard hit = 0;
+    for (int i = 0; i < st->count; i++) {
+        int tx = x + st->dx[i], ty = y + st->dy[i];
+        if (is_valid_position(tx, ty)) hit |= enemies & cell_bit(tx, ty);
+    }
+    return hit;
+}
+
+// Blasts hit whatever is there, but a caster only counts the enemies it sees
+int count_blast_targets(const Battlefield *bf, const UNIT *unit, int x, int y) {
+    Bitboard hit = blast_targets(bf, unit, x, y);
+    int team = team_at(bf, x, y);
+    if (team) hit &= team_sight(bf, team);
+    return bb_count(hit);
+}
+
+// Resolves a blast centered on the caster at (x, y) as one batch: damage is
+// applied to every enemy under the stencil, the dead are dropped in a single
+// pass over the enemy roster and one summary message is shown.
+bool use_special_ability(Battlefield *bf, const UNIT *unit, int x, int y, int *remaining_units) {
+    const ITEM *item = special_item(unit);
+    if (!item) return false;
+    
+    int team = team_at(bf, x, y);
+    Bitboard enemies = enemy_cells(bf, team);
+    const BlastStencil *st = blast_stencil(item->radius);
+    
+    // Show who is casting
+    bf->has_selection = true;
+    bf->selected_pos = (Position){x, y};
+    update_all_displays(bf->main_win, bf, unit);
+    battle_pause(bf, 300000);
+    
+    int hits = 0, kills = 0, total_damage = 0;
+    for (int i = 0; i < st->count; i++) {
+        int tx = x + st->dx[i], ty = y + st->dy[i];
+        if (!is_valid_position(tx, ty)) continue;
+        
+        if (!(enemies & cell_bit(tx, ty))) continue;
+        
+        UNIT *target = unit_at(bf, tx, ty);
+        int damage = attack_damage(bf, unit, tx, ty);
+        damage_unit(bf, tx, ty, damage);
+        eventlog_hit(unit, target, damage, manhattan_distance(x, y, tx, ty), bf->round,
+                     target->hp <= 0);
+        total_damage += damage;
+        hits++;
+        if (target->hp <= 0) kills++;
+        else apply_effect(bf, HANDLE_SLOT(bf->cells[ty][tx].handle), item);
+    }
     
-    // Time to create some fireworks! Let's hit everything in range
-    int radius = special_item->radius;
-    for (int dy = -radius; dy <= radius; dy++) {
-        for (int dx = -radius; dx <= radius; dx++) {
-            int target_x = x + dx;
-            int target_y = y + dy;
-            
-            // Make sure we don't try to attack outside the battlefield
-            if (!is_valid_position(target_x, target_y)) continue;
-            
-            // Check if there's an enemy unit at this spot
-            UNIT *target = bf->cells[target_y][target_x].unit;
-            if (target && bf->cells[target_y][target_x].team != bf->cells[y][x].team) {
-                // Calculate and deal the damage
-                int damage = calculate_damage(unit, target);
-                target->hp -= damage;
-                
-                // Let everyone know what happened!
-                display_combat_message(bf, "%s hits %s for %d area damage!",
-                                     unit->name, target->name, damage);
-                
-                // Check if we defeated the target
-                if (target->hp <= 0) {
-                    display_combat_message(bf, "%s has been defeated!", target->name);
-                    remove_unit(bf, target_x, target_y);
-                }
+    if (kills > 0) {
+        // Only units caught in this blast can be at 0 hp
+        int enemy = team == 1 ? 1 : 0;
+        int kept = 0;
+        for (int i = 0; i < bf->unit_counts[enemy]; i++) {
+            UnitHandle h = bf->roster[enemy][i];
+            UnitSlot *slot = &bf->slots[HANDLE_SLOT(h)];
+            if (slot->unit->hp > 0) {
+                slot->index = kept;
+                bf->roster[enemy][kept++] = h;
+            } else {
+                free_slot(bf, HANDLE_SLOT(h));
             }
         }
+        bf->unit_counts[enemy] = kept;
+        *remaining_units -= kills;
+    }
+    
+    if (hits == 0) {
+        display_combat_message(bf, "%s's %s hits nothing", unit->name, item->name);
+    } else if (kills > 0) {
+        display_combat_message(bf, "%s's %s hits %d %s for %d damage, %d defeated!",
+                               unit->name, item->name, hits, hits == 1 ? "enemy" : "enemies",
+                               total_damage, kills);
+    } else {
+        display_combat_message(bf, "%s's %s hits %d %s for %d damage!",
+                               unit->name, item->name, hits, hits == 1 ? "enemy" : "enemies",
+                               total_damage);
     }
+    
+    bf->has_selection = false;
+    update_all_displays(bf->main_win, bf, NULL);
+    battle_pause(bf, 500000);
+    return true;
 }
 
+// Reports a hit; the damage has already been applied with damage_unit
 void update_combat_stats(Battlefield *bf, UNIT *attacker, UNIT *target, int damage) {
-    // Update target's HP
-    target->hp -= damage;
-    
     // Update all displays to show new stats
     display_combat_message(bf, "%s hits %s for %d damage! %s HP: %d",
                          attacker->name, target->name, damage,
                          target->name, target->hp);
     
     // Flash the target's position
-    wattron(bf->status_win, A_BOLD | COLOR_PAIR(2));  // Red for damage
-    wrefresh(bf->status_win);
-    usleep(100000);  // Brief flash
-    wattroff(bf->status_win, A_BOLD | COLOR_PAIR(2));
+    if (!bf->ansi) {
+        wattron(bf->status_win, A_BOLD | COLOR_PAIR(2));  // Red for damage
+        wrefresh(bf->status_win);
+    }
+    battle_pause(bf, 100000);  // Brief flash
+    if (!bf->ansi) wattroff(bf->status_win, A_BOLD | COLOR_PAIR(2));
     
     // Update all displays immediately
     update_unit_list(bf);
-    wrefresh(bf->status_win);
-    wrefresh(bf->unit_list_win);
+    if (!bf->ansi) {
+        wrefresh(bf->status_win);
+        wrefresh(bf->unit_list_win);
+    }
 }
 
 bool perform_combat(Battlefield *bf, Position *att_pos, Position *target_pos, int *remaining_units) {
-    UNIT *attacker = bf->cells[att_pos->y][att_pos->x].unit;
-    UNIT *target = bf->cells[target_pos->y][target_pos->x].unit;
+    TRACE_SCOPE("perform_combat");
+    UNIT *attacker = unit_at(bf, att_pos->x, att_pos->y);
+    UNIT *target = unit_at(bf, target_pos->x, target_pos->y);
     
     if (!attacker || !target) return false;
     
     // Highlight attacker
+    trace_begin("combat_highlight");
     bf->cursor_pos = *att_pos;
     bf->has_selection = true;
     bf->selected_pos = *att_pos;
     update_all_displays(bf->main_win, bf, attacker);
-    usleep(300000);
+    battle_pause(bf, 300000);
     
     // Show attack animation
     bf->cursor_pos = *target_pos;
     update_all_displays(bf->main_win, bf, attacker);
-    usleep(300000);
+    battle_pause(bf, 300000);
+    trace_end("combat_highlight");
     
     // Calculate and apply damage
-    int damage = calculate_damage(attacker, target);
+    trace_begin("combat_damage");
+    int damage = attack_damage(bf, attacker, target_pos->x, target_pos->y);
+    damage_unit(bf, target_pos->x, target_pos->y, damage);
+    eventlog_hit(attacker, target, damage,
+                 manhattan_distance(att_pos->x, att_pos->y, target_pos->x, target_pos->y), bf->round,
+                 target->hp <= 0);
     update_combat_stats(bf, attacker, target, damage);
+    trace_end("combat_damage");
     
     // Check for defeat
     if (target->hp <= 0) {
+        TRACE_SCOPE("combat_defeat");
         display_combat_message(bf, "%s has been defeated!", target->name);
         remove_unit(bf, target_pos->x, target_pos->y);
         (*remaining_units)--;
         update_all_displays(bf->main_win, bf, NULL);
-        usleep(500000);
+        battle_pause(bf, 500000);
     }
     
     // Reset selection
+    trace_begin("combat_reset");
     bf->has_selection = false;
     update_all_displays(bf->main_win, bf, NULL);
-    usleep(300000);
+    battle_pause(bf, 300000);
+    trace_end("combat_reset");
     
     return true;
 }
 
-void highlight_valid_moves(WINDOW *win, const Battlefield *bf, int x, int y) {
+static void highlight_cells(WINDOW *win, const Battlefield *bf, Bitboard cells, int color) {
     const GridDimensions *dims = &bf->grid_dims;
     
-    // Check all positions within movement range (2 squares)
-    for (int dy = -2; dy <= 2; dy++) {
-        for (int dx = -2; dx <= 2; dx++) {
-            int new_x = x + dx;
-            int new_y = y + dy;
-            
-            if (is_valid_move(bf, x, y, new_x, new_y)) {
-                int px = dims->start_x + new_x * dims->cell_width;
-                int py = dims->start_y + new_y * dims->cell_height;
-                
-                // Highlight valid move squares in blue
-                wattron(win, COLOR_PAIR(1) | A_DIM);
-                mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
-                mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
-                mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
-                mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
-                wattroff(win, COLOR_PAIR(1) | A_DIM);
-            }
-        }
+    cells &= grid_view_mask(dims);
+    wattron(win, COLOR_PAIR(color) | A_DIM);
+    while (cells) {
+        int cell = bb_pop(&cells);
+        frame_cell(win, dims, cell % MAX_GRID_WIDTH, cell / MAX_GRID_WIDTH, false);
     }
+    wattroff(win, COLOR_PAIR(color) | A_DIM);
+}
+
+void highlight_valid_moves(WINDOW *win, const Battlefield *bf, int x, int y) {
+    // Highlight valid move squares in blue
+    highlight_cells(win, bf, move_targets(bf, x, y), 1);
 }
 
 void highlight_attack_range(WINDOW *win, const Battlefield *bf, const UNIT *unit, int x, int y) {
     if (!unit || !unit->item1) return;
     
-    const GridDimensions *dims = &bf->grid_dims;
-    int max_range = unit->item1->range;
-    if (unit->item2 && unit->item2->range > max_range) {
-        max_range = unit->item2->range;
-    }
-    
-    // Check all positions within attack range
-    for (int dy = -max_range; dy <= max_range; dy++) {
-        for (int dx = -max_range; dx <= max_range; dx++) {
-            int target_x = x + dx;
-            int target_y = y + dy;
-            
-            if (is_valid_position(target_x, target_y)) {
-                int dist = manhattan_distance(x, y, target_x, target_y);
-                if (dist <= max_range) {
-                    int px = dims->start_x + target_x * dims->cell_width;
-                    int py = dims->start_y + target_y * dims->cell_height;
-                    
-                    // Highlight attack range squares in yellow
-                    wattron(win, COLOR_PAIR(3) | A_DIM);
-                    mvwhline(win, py, px, ACS_HLINE, dims->cell_width);
-                    mvwhline(win, py + dims->cell_height - 1, px, ACS_HLINE, dims->cell_width);
-                    mvwvline(win, py, px, ACS_VLINE, dims->cell_height);
-                    mvwvline(win, py, px + dims->cell_width - 1, ACS_VLINE, dims->cell_height);
-                    wattroff(win, COLOR_PAIR(3) | A_DIM);
-                }
-            }
-        }
-    }
-} 
\ No newline at end of file
+    // Highlight the squares in range and in line of sight in yellow
+    highlight_cells(win, bf, line_of_sight_cells(bf, x, y, unit_range(unit)), 3);
+}
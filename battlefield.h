@@ -2,7 +2,11 @@
 #define BATTLEFIELD_H
 
 #include <ncurses.h>
+#include <stdint.h>
 #include "data.h"
+#include "density.h"
+#include "combatlog.h"
+#include "terrain.h"
 
 // Minimum window dimensions
 #define MIN_WINDOW_WIDTH  80
@@ -11,6 +15,19 @@
 // Grid dimensions (will scale based on window size)
 #define MAX_GRID_WIDTH  10
 #define MAX_GRID_HEIGHT 10
+_Static_assert(MAX_GRID_WIDTH <= DENSITY_MAX_SIDE && MAX_GRID_HEIGHT <= DENSITY_MAX_SIDE,
+               "the density pyramid must cover the board");
+
+// Where game screens put their main window. The side panels are placed in
+// screen coordinates, the board inside the main window.
+#define MAIN_WIN_Y 2
+#define MAIN_WIN_X 1
+
+// Board cell size range; cells grow with the space left by the panels
+#define MIN_CELL_WIDTH  6
+#define MIN_CELL_HEIGHT 3
+#define MAX_CELL_WIDTH  12
+#define MAX_CELL_HEIGHT 5
 
 // Panel dimensions (will scale based on window size)
 #define MIN_STATUS_HEIGHT 8
@@ -19,6 +36,11 @@
 #define MIN_UNIT_LIST_WIDTH 35
 #define MIN_HINTS_HEIGHT 3
 #define MIN_MESSAGE_HEIGHT 3
+#define MINIMAP_WIDTH 12        // Two columns per minimap pixel, plus the border
+
+// Largest blast radius with a precomputed stencil
+#define MAX_BLAST_RADIUS 3
+#define BLAST_STENCIL_MAX ((2 * MAX_BLAST_RADIUS + 1) * (2 * MAX_BLAST_RADIUS + 1))
 
 // Item selection menu dimensions
 #define ITEM_MENU_WIDTH 40
@@ -54,39 +76,277 @@ typedef struct {
     bool has_special;
 } ActionMenu;
 
+typedef struct {
+    int x, y;
+} Position;
+
+// Stable reference to a unit on the board: slot index in the low byte,
+// slot generation above it. A handle goes stale as soon as its unit is
+// removed, so it can be kept across removals without dangling.
+typedef uint32_t UnitHandle;
+
+#define NO_UNIT 0
+#define UNIT_SLOTS (2 * MAX_ARMY)
+#define HANDLE_SLOT(h) ((h) & 0xFF)
+#define HANDLE_GENERATION(h) ((h) >> 8)
+
+typedef struct {
+    UNIT *unit;             // NULL while the slot is free
+    Position pos;
+    int team;               // 1 or 2
+    int index;              // Position in the team's roster
+    uint32_t generation;    // Bumped whenever the slot is freed
+} UnitSlot;
+
 // Grid cell structure
 typedef struct {
-    UNIT *unit;
-    int team;  // 1 or 2
+    UnitHandle handle;      // NO_UNIT when empty
 } GridCell;
 
+// One bit per grid cell, bit y * MAX_GRID_WIDTH + x. The whole 10x10 board
+// fits in a single 128-bit word, so move and target sets are a few ANDs.
+typedef unsigned __int128 Bitboard;
+
+#define BOARD_CELLS (MAX_GRID_WIDTH * MAX_GRID_HEIGHT)
+#define MOVE_RANGE 2            // Movement points per turn; a plain square costs one
+#define MAX_ATTACK_RANGE 4      // Longest range with a precomputed mask
+
+static inline Bitboard cell_bit(int x, int y) {
+    return (Bitboard)1 << (y * MAX_GRID_WIDTH + x);
+}
+
+// Returns the lowest set cell index and clears it. b must not be empty.
+static inline int bb_pop(Bitboard *b) {
+    uint64_t low = (uint64_t)*b;
+    int idx = low ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(*b >> 64));
+    *b &= *b - 1;
+    return idx;
+}
+
+static inline int bb_count(Bitboard b) {
+    return __builtin_popcountll((uint64_t)b) + __builtin_popcountll((uint64_t)(b >> 64));
+}
+
+#define BOARD_MASK (((Bitboard)1 << BOARD_CELLS) - 1)
+
+// How far units see: the base radius, or one past their longest reach
+#define SIGHT_RADIUS 3
+#define MAX_SIGHT_RADIUS 5
+
+// Per-team fog of war. Every unit adds a reference to each cell in its field
+// of view and a team sees the cells with at least one. When a cell changes,
+// only the units whose view could reach it recast their field of view.
 typedef struct {
-    int x, y;
-} Position;
+    bool enabled;                   // false: both teams see the whole board
+    int viewer;                     // Team whose view is drawn, 0 = both
+    uint8_t refs[2][BOARD_CELLS];   // Units of each team seeing each cell
+    Bitboard visible[2];            // Cells with refs, per team
+    Bitboard sight[UNIT_SLOTS];     // Cells each slot's unit holds refs on
+} FogOfWar;
+
+// Units take turns in initiative order: each waits in an indexed binary
+// min-heap keyed by the time of its next action, ties going to the lower
+// slot. Acting adds the unit's delay to its time, so lighter units act more
+// often. A round is ROUND_TIME of that time.
+#define ROUND_TIME 20
+#define INITIATIVE_BASE 14      // Delay of an unarmed unit
+#define NOT_QUEUED (-1)
+
+typedef struct {
+    uint32_t ready[UNIT_SLOTS]; // Time each slot next acts
+    int8_t heap[UNIT_SLOTS];    // Queued slots, heap ordered
+    int8_t index[UNIT_SLOTS];   // Each slot's place in heap[], NOT_QUEUED if absent
+    int count;
+    uint32_t now;               // Time of the last turn taken
+} Initiative;
+
+// Status effects run on a clock that ticks twice a round: every half
+// ROUND_TIME in initiative order, or after each simultaneous round resolves.
+// Durations are in rounds.
+#define TICKS_PER_ROUND 2
+#define EFFECT_TICK_TIME (ROUND_TIME / TICKS_PER_ROUND)
+#define EFFECT_TYPES (EFFECT_COUNT - 1)
+#define EFFECT_TIMERS (UNIT_SLOTS * EFFECT_TYPES)
+#define WHEEL_SLOTS 16
+#define WHEEL_LEVELS 2
+#define WHEEL_SPAN (WHEEL_SLOTS * WHEEL_SLOTS)  // Longest delay is one tick less
+#define NO_TIMER (-1)
+
+// One per unit slot and effect type, timer id = slot * EFFECT_TYPES + type - 1
+typedef struct {
+    uint16_t due;           // Tick it fires at
+    int8_t next, prev;      // Neighbours in its bucket, NO_TIMER at the ends
+    int8_t bucket;          // level * WHEEL_SLOTS + index, NO_TIMER while idle
+    uint8_t left;           // Firings to go; the effect holds while above 0
+    uint8_t power;          // Burn damage, or share of damage a shield stops
+} EffectTimer;
+
+// Hierarchical timer wheel. Level 0 has a bucket for each of the next 16
+// ticks, level 1 a bucket for each of the 16 spans of 16 ticks after that.
+// When the clock enters a span its level 1 bucket is spread over level 0,
+// so a tick only walks the timers that fire on it.
+typedef struct {
+    uint16_t now;
+    int8_t heads[WHEEL_LEVELS][WHEEL_SLOTS];
+    EffectTimer timers[EFFECT_TIMERS];
+} EffectWheel;
+
+// A unit's effects relative to the current tick, for snapshots
+typedef struct {
+    uint8_t wait;           // Ticks to the next firing, 0 = not under the effect
+    uint8_t left;
+    uint8_t power;
+} EffectState;
+
+typedef struct {
+    EffectState of[EFFECT_TYPES];   // Indexed by EffectType - 1
+} UnitEffects;
+
+// What one tick of the effect clock did
+typedef struct {
+    int burns;              // Units that took burn damage
+    int damage;
+    int defeated[2];        // Units each team lost to burns
+} EffectReport;
 
+// The part of the board that fits in the main window. When the whole board
+// doesn't fit, the view scrolls to keep the cursor in sight.
 typedef struct {
-    int width;          // Actual grid width based on window size
-    int height;         // Actual grid height based on window size
+    int width;          // Cells visible across, based on window size
+    int height;         // Cells visible down, based on window size
     int cell_width;     // Width of each cell in characters
     int cell_height;    // Height of each cell in characters
     int start_x;        // Starting X position of grid
     int start_y;        // Starting Y position of grid
+    int view_x;         // Board cell shown in the top left corner
+    int view_y;
 } GridDimensions;
 
+// Window position of board cell (x, y); false when it is scrolled out of view
+static inline bool grid_cell_origin(const GridDimensions *dims, int x, int y, int *px, int *py) {
+    int vx = x - dims->view_x, vy = y - dims->view_y;
+    if (vx < 0 || vy < 0 || vx >= dims->width || vy >= dims->height) return false;
+    *px = dims->start_x + vx * dims->cell_width;
+    *py = dims->start_y + vy * dims->cell_height;
+    return true;
+}
+
+// Cells inside the view, so drawing can skip the rest of a mask
+static inline Bitboard grid_view_mask(const GridDimensions *dims) {
+    Bitboard row = (((Bitboard)1 << dims->width) - 1) << dims->view_x;
+    Bitboard mask = 0;
+    for (int y = dims->view_y; y < dims->view_y + dims->height; y++) {
+        mask |= row << (y * MAX_GRID_WIDTH);
+    }
+    return mask;
+}
+
+// Screen rectangle of a panel
+typedef struct {
+    int y, x;
+    int height, width;
+} Rect;
+
+// Where each side panel goes for a given parent window size
+typedef struct {
+    Rect status;
+    Rect minimap;       // Left of the status panel, as tall as it
+    Rect unit_list;
+    Rect hints;
+    Rect message;
+} PanelLayout;
+
+// Unit list panel ordering
+typedef enum {
+    SORT_BY_TEAM,
+    SORT_BY_HP,
+    SORT_BY_DISTANCE,   // Distance to the cursor
+    SORT_MODE_COUNT
+} UnitSortMode;
+
+#define UNIT_LIST_MAX (2 * MAX_ARMY)
+#define UNIT_LIST_LINE 64
+#define UNIT_LIST_NAME 20           // Unit and item names are cut to this
+
+// One unit's rows in the unit list. The text is formatted lazily, the first
+// time the rows are visible after the unit's hp, position or effects changed.
+typedef struct {
+    const UNIT *unit;
+    int team;
+    Position pos;
+    int hp;
+    int effects;                // Bit (1 << type) for each effect on the unit
+    int sort_key;
+    int line_count;             // Name line, item 1 and optionally item 2
+    bool dirty;                 // lines[] no longer match hp/pos/effects
+    bool seen;                  // Still on the board at the last sync
+    char lines[3][UNIT_LIST_LINE];
+} UnitListEntry;
+
+// Scrollable view over all units. Only the rows inside the panel are drawn.
+typedef struct {
+    UnitListEntry entries[UNIT_LIST_MAX];
+    int order[UNIT_LIST_MAX];   // Indices into entries, kept sorted by sort_key
+    int row_start[UNIT_LIST_MAX]; // First row of each entry, in sorted order
+    int count;
+    int rows;                   // Total rows including army headers
+    int scroll;                 // First visible row
+    UnitSortMode sort;
+} UnitListView;
+
+// A single row of the unit list, as both renderers draw it
+typedef struct {
+    const char *text;
+    int color;      // Color pair
+    int indent;
+    bool header;
+} UnitListRow;
+
+// A single minimap pixel, as both renderers draw it. Each pixel covers a
+// block of board cells, 1x1 up to the whole board depending on the level.
+typedef struct {
+    char glyph;     // '.' empty, 'o' one unit, 'O' a few, '@' crowded, ' ' out of sight
+    int color;      // Color pair: team 1, team 2, or 3 when both are there
+    int shade;      // -1 low, 0 medium, 1 high average hp
+    bool in_view;   // Overlaps the part of the board in the main window
+} MinimapPixel;
+
+struct AnsiRenderer;
+struct CastRecorder;
+
 typedef struct {
     GridCell cells[MAX_GRID_HEIGHT][MAX_GRID_WIDTH];
-    Position positions[2][5];  // Store positions for each team's units
+    UnitSlot slots[UNIT_SLOTS]; // Slot map owning every unit on the board
+    UnitHandle roster[2][MAX_ARMY]; // Dense list of each team's live units
+    int free_slots[UNIT_SLOTS]; // Stack of unused slot indices
+    int free_count;
     int unit_counts[2];       // Store unit count for each team
+    Bitboard occupied[2];     // Cells held by each team
+    DensityPyramid density;   // Unit counts and hp per team, for the minimap
+    FogOfWar fog;             // What each team can see
+    uint8_t terrain[MAX_GRID_HEIGHT][MAX_GRID_WIDTH]; // Terrain of each cell
+    Bitboard impassable;      // Terrain no unit can enter
+    Bitboard opaque;          // Terrain that blocks sight
+    Bitboard reach[UNIT_SLOTS]; // Cells each slot's unit can move to this turn
+    EffectWheel effects;      // Freeze, burn and shield timers of every slot
+    Initiative initiative;    // Turn order of the units on the board
+    int round;                // Round being played, for the event log
     WINDOW *main_win;         // Main game window
     WINDOW *status_win;       // Window for displaying unit status
     WINDOW *message_win;      // Window for displaying combat messages
+    CombatLog *log;           // Scrollback of those messages, owned by the game loop; NULL = none
     WINDOW *unit_list_win;    // Window for displaying all units' status
     WINDOW *hints_win;        // Window for displaying context-sensitive hints
+    WINDOW *minimap_win;      // Window for the overview of the whole board
     Position cursor_pos;      // Current cursor position
     Position selected_pos;    // Currently selected unit position
     bool has_selection;       // Whether a unit is currently selected
     GameState state;          // Current game state
     GridDimensions grid_dims; // Current grid dimensions
+    PanelLayout layout;       // Current panel placement
+    UnitListView unit_list;   // Sorted, scrollable unit list panel state
+    struct AnsiRenderer *ansi; // Optional framebuffer renderer, NULL = draw with ncurses
+    struct CastRecorder *recorder; // When set, pauses advance the recording clock instead of sleeping
 } Battlefield;
 
 // Item selection menu structure
@@ -99,31 +359,141 @@ typedef struct {
     int num_items;
 } ItemMenu;
 
+// Cells only ever hold live handles, so these need no generation check
+static inline const UnitSlot *slot_at(const Battlefield *bf, int x, int y) {
+    UnitHandle h = bf->cells[y][x].handle;
+    return h ? &bf->slots[HANDLE_SLOT(h)] : NULL;
+}
+
+static inline UNIT *unit_at(const Battlefield *bf, int x, int y) {
+    const UnitSlot *slot = slot_at(bf, x, y);
+    return slot ? slot->unit : NULL;
+}
+
+static inline int team_at(const Battlefield *bf, int x, int y) {
+    const UnitSlot *slot = slot_at(bf, x, y);
+    return slot ? slot->team : 0;
+}
+
+// The i-th live unit of a team (0 or 1), for dense iteration
+static inline const UnitSlot *roster_slot(const Battlefield *bf, int team_idx, int i) {
+    return &bf->slots[HANDLE_SLOT(bf->roster[team_idx][i])];
+}
+
+// Handle of the unit in an occupied slot
+static inline UnitHandle slot_handle(const Battlefield *bf, int slot) {
+    const UnitSlot *s = &bf->slots[slot];
+    return bf->roster[s->team - 1][s->index];
+}
+
+// Cells team (1 or 2) can see
+static inline Bitboard team_sight(const Battlefield *bf, int team) {
+    return bf->fog.enabled ? bf->fog.visible[team - 1] : BOARD_MASK;
+}
+
+// Cells the drawn view shows: the viewer's sight, or what either team sees.
+// Units always see their own cell, so only enemies can fall outside it.
+static inline Bitboard fog_view(const Battlefield *bf) {
+    if (!bf->fog.enabled) return BOARD_MASK;
+    if (bf->fog.viewer == 1 || bf->fog.viewer == 2) return bf->fog.visible[bf->fog.viewer - 1];
+    return bf->fog.visible[0] | bf->fog.visible[1];
+}
+
+static inline bool has_effect(const Battlefield *bf, int slot, EffectType type) {
+    return bf->effects.timers[slot * EFFECT_TYPES + type - 1].left > 0;
+}
+
+static inline bool fog_hides(const Battlefield *bf, int x, int y) {
+    return !(fog_view(bf) & cell_bit(x, y));
+}
+
 // Function declarations
 int manhattan_distance(int x1, int y1, int x2, int y2);
 void init_battlefield(Battlefield *bf);
 bool is_valid_position(int x, int y);
-void place_unit(Battlefield *bf, UNIT *unit, int team, int x, int y);
+UnitHandle place_unit(Battlefield *bf, UNIT *unit, int team, int x, int y);
+void clear_units(Battlefield *bf);
 void remove_unit(Battlefield *bf, int x, int y);
+void damage_unit(Battlefield *bf, int x, int y, int damage);
+void set_terrain(Battlefield *bf, const uint8_t *cells);
+const UnitSlot *unit_slot(const Battlefield *bf, UnitHandle h);
 void draw_battlefield(WINDOW *win, const Battlefield *bf);
 
+// Bitboard queries
+Bitboard range_mask(int x, int y, int range);
+Bitboard enemy_cells(const Battlefield *bf, int team);
+Bitboard move_targets(const Battlefield *bf, int x, int y);
+Bitboard reachable_cells(const Battlefield *bf, int x, int y, int budget);
+Bitboard attack_targets(const Battlefield *bf, const UNIT *unit, int x, int y);
+bool has_line_of_sight(const Battlefield *bf, int x1, int y1, int x2, int y2);
+Bitboard line_of_sight_cells(const Battlefield *bf, int x, int y, int range);
+int unit_range(const UNIT *unit);
+bool closest_attack_target(const Battlefield *bf, const UNIT *unit, int x, int y, Position *target);
+
+// Fog of war
+int unit_sight(const UNIT *unit);
+Bitboard field_of_view(const Battlefield *bf, int x, int y, int radius);
+void fog_enable(Battlefield *bf, bool enabled);
+void fog_update(Battlefield *bf, int slot, Bitboard changed);
+
+// Status effects
+void effects_reset(EffectWheel *wheel);
+void apply_effect(Battlefield *bf, int slot, const ITEM *item);
+bool brace_unit(Battlefield *bf, int slot);
+void clear_effects(Battlefield *bf, int slot);
+void effects_tick(Battlefield *bf, EffectReport *report);
+void get_unit_effects(const Battlefield *bf, int slot, UnitEffects *out);
+void set_unit_effects(Battlefield *bf, int slot, const UnitEffects *fx);
+int attack_damage(const Battlefield *bf, const UNIT *attacker, int x, int y);
+
+// Turn order
+int unit_delay(const UNIT *unit);
+void initiative_reset(Initiative *q);
+void initiative_add(Battlefield *bf, int slot);
+void initiative_remove(Battlefield *bf, int slot);
+void initiative_set(Battlefield *bf, int slot, uint32_t ready);
+void initiative_act(Battlefield *bf, int slot);
+
+// Slot of the unit that acts next, or -1 with the board empty
+static inline int initiative_next(const Battlefield *bf) {
+    return bf->initiative.count ? bf->initiative.heap[0] : -1;
+}
+
 // Window management functions
 void create_status_windows(Battlefield *bf, int parent_height, int parent_width);
 void destroy_status_windows(Battlefield *bf);
 void resize_windows(Battlefield *bf, WINDOW *main_win);
 void calculate_grid_dimensions(Battlefield *bf, int parent_height, int parent_width);
+void viewport_follow(Battlefield *bf, int x, int y);
+void calculate_panel_layout(PanelLayout *layout, int parent_height, int parent_width);
+void invalidate_display(Battlefield *bf);
+void battle_pause(Battlefield *bf, long usec);
 bool check_window_size(int height, int width);
 
 // Display functions
 void update_status_panel(Battlefield *bf, const UNIT *selected_unit, const Position *cursor_pos);
 void display_combat_message(Battlefield *bf, const char *format, ...);
+void browse_combat_log(Battlefield *bf);
 void display_controls_hint(Battlefield *bf, const char *hint);
 void update_unit_list(Battlefield *bf);
+void update_minimap(Battlefield *bf);
 void highlight_cursor(WINDOW *win, const Battlefield *bf);
 void highlight_selected_unit(WINDOW *win, const Battlefield *bf);
 void update_all_displays(WINDOW *win, Battlefield *bf, const UNIT *selected_unit);
 const char *get_item_summary(const ITEM *item);
 
+// Unit list view
+void unit_list_sync(Battlefield *bf);
+int unit_list_rows(const Battlefield *bf);
+bool unit_list_row(Battlefield *bf, int row, UnitListRow *out);
+void unit_list_scroll(Battlefield *bf, int delta, int visible);
+void unit_list_cycle_sort(Battlefield *bf);
+const char *unit_list_sort_name(UnitSortMode mode);
+
+// Minimap view
+int minimap_level(const Battlefield *bf);
+void minimap_pixel(const Battlefield *bf, int level, int mx, int my, MinimapPixel *out);
+
 // New hint system functions
 void update_hints(Battlefield *bf);
 const char *get_state_hint(GameState state);
@@ -150,7 +520,10 @@ ActionType show_action_menu(ActionMenu *menu, const UNIT *unit);
 void update_action_menu(ActionMenu *menu, const UNIT *unit);
 bool is_valid_move(const Battlefield *bf, int from_x, int from_y, int to_x, int to_y);
 bool has_special_ability(const UNIT *unit);
-void use_special_ability(Battlefield *bf, const UNIT *unit, int x, int y);
+const ITEM *special_item(const UNIT *unit);   // The item a special ability uses, or NULL
+Bitboard blast_targets(const Battlefield *bf, const UNIT *unit, int x, int y);
+int count_blast_targets(const Battlefield *bf, const UNIT *unit, int x, int y);
+bool use_special_ability(Battlefield *bf, const UNIT *unit, int x, int y, int *remaining_units);
 
 // Visual feedback functions
 void highlight_valid_moves(WINDOW *win, const Battlefield *bf, int x, int y);
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cast.h"
+
+static void cast_flush(CastRecorder *rec) {
+    size_t off = 0;
+    while (off < rec->len && !rec->failed) {
+        ssize_t n = write(rec->fd, rec->buf + off, rec->len - off);
+        if (n <= 0) rec->failed = true;
+        else off += (size_t)n;
+    }
+    rec->len = 0;
+}
+
+static void cast_write(CastRecorder *rec, const char *data, size_t len) {
+    while (len > 0) {
+        if (rec->len == sizeof rec->buf) cast_flush(rec);
+        size_t n = sizeof rec->buf - rec->len;
+        if (n > len) n = len;
+        memcpy(rec->buf + rec->len, data, n);
+        rec->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// Appends `data` as the body of a JSON string
+static void cast_write_escaped(CastRecorder *rec, const char *data, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        cast_write(rec, data + start, i - start);
+        char esc[8];
+        int n;
+        if (c == '"' || c == '\\') n = snprintf(esc, sizeof esc, "\\%c", c);
+        else if (c == '\n') n = snprintf(esc, sizeof esc, "\\n");
+        else if (c == '\r') n = snprintf(esc, sizeof esc, "\\r");
+        else n = snprintf(esc, sizeof esc, "\\u%04x", c);
+        cast_write(rec, esc, (size_t)n);
+        start = i + 1;
+    }
+    cast_write(rec, data + start, len - start);
+}
+
+CastRecorder *cast_open(const char *path, int width, int height, const char *title) {
+    CastRecorder *rec = calloc(1, sizeof *rec);
+    if (!rec) return NULL;
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (rec->fd < 0) {
+        free(rec);
+        return NULL;
+    }
+
+    char header[256];
+    int n = snprintf(header, sizeof header,
+                     "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %ld, "
+                     "\"env\": {\"TERM\": \"xterm-256color\"}, \"title\": \"",
+                     width, height, (long)time(NULL));
+    cast_write(rec, header, (size_t)n);
+    cast_write_escaped(rec, title, strlen(title));
+    cast_write(rec, "\"}\n", 3);
+    return rec;
+}
+
+void cast_advance(CastRecorder *rec, long long usec) {
+    rec->clock_us += usec;
+}
+
+void cast_sink(void *ctx, const char *data, size_t len) {
+    CastRecorder *rec = ctx;
+    char stamp[48];
+    int n = snprintf(stamp, sizeof stamp, "[%lld.%06lld, \"o\", \"",
+                     rec->clock_us / 1000000, rec->clock_us % 1000000);
+    cast_write(rec, stamp, (size_t)n);
+    cast_write_escaped(rec, data, len);
+    cast_write(rec, "\"]\n", 3);
+    rec->events++;
+}
+
+bool cast_close(CastRecorder *rec) {
+    cast_flush(rec);
+    bool ok = !rec->failed && close(rec->fd) == 0;
+    free(rec);
+    return ok;
+}
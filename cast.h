@@ -0,0 +1,29 @@
+#ifndef CAST_H
+#define CAST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Terminal size used for recordings
+#define CAST_ROWS 40
+#define CAST_COLS 120
+#define CAST_BUFFER_SIZE (64 * 1024)
+
+// Writes an asciicast v2 file. Time is logical: it only moves when the game
+// pauses, so a battle records as fast as the CPU allows but plays back at the
+// pace it would have had on screen.
+typedef struct CastRecorder {
+    int fd;
+    char buf[CAST_BUFFER_SIZE];
+    size_t len;
+    long long clock_us;     // Playback position of the next event
+    long events;
+    bool failed;
+} CastRecorder;
+
+CastRecorder *cast_open(const char *path, int width, int height, const char *title);
+void cast_advance(CastRecorder *rec, long long usec);
+void cast_sink(void *ctx, const char *data, size_t len);
+bool cast_close(CastRecorder *rec);
+
+#endif // CAST_H
@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "battlefield.h"
+#include "protocol.h"
+#include "client.h"
+
+static int client_connect(const char *socket_path) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof addr.sun_path) return -1;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof addr) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool send_frame(int fd, uint8_t type, uint16_t match_id, const uint8_t *payload, size_t len) {
+    uint8_t frame[PROTO_MAX_FRAME];
+    if (len > PROTO_MAX_PAYLOAD) return false;
+    size_t off = proto_write_header(frame, type, match_id, (uint16_t)len);
+    if (len) memcpy(frame + off, payload, len);
+    return write_all(fd, frame, off + len);
+}
+
+static bool recv_frame(int fd, MessageHeader *hdr, uint8_t *payload) {
+    uint8_t head[PROTO_HEADER_SIZE];
+    if (!read_all(fd, head, sizeof head)) return false;
+    proto_read_header(head, sizeof head, hdr);
+    if (hdr->len > PROTO_MAX_PAYLOAD) return false;
+    return read_all(fd, payload, hdr->len);
+}
+
+static bool send_action(int fd, uint16_t match_id, NetActionKind kind,
+                        int fx, int fy, int tx, int ty) {
+    NetAction act = {(uint8_t)kind, (uint8_t)fx, (uint8_t)fy, (uint8_t)tx, (uint8_t)ty};
+    uint8_t payload[8];
+    size_t len = proto_encode_action(payload, sizeof payload, &act);
+    return send_frame(fd, MSG_ACTION, match_id, payload, len);
+}
+
+// Creates a match and waits for its id; returns 0 on failure
+static uint16_t create_match(int fd, const UNIT a1[], int n1, const UNIT a2[], int n2) {
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    size_t len = proto_encode_armies(payload, sizeof payload, a1, n1, a2, n2);
+    if (!len || !send_frame(fd, MSG_CREATE, 0, payload, len)) return 0;
+
+    MessageHeader hdr;
+    if (!recv_frame(fd, &hdr, payload) || hdr.type != MSG_CREATED) return 0;
+    return hdr.match_id;
+}
+
+// Rebuilds the local board from a server snapshot. Units live in `units`.
+static void apply_state(Battlefield *bf, UNIT units[], const NetState *st) {
+    clear_units(bf);
+    for (int i = 0; i < st->count; i++) {
+        const NetUnit *nu = &st->units[i];
+        UNIT *u = &units[i];
+        memset(u, 0, sizeof *u);
+        strncpy(u->name, nu->name, MAX_NAME);
+        u->hp = nu->hp;
+        u->item1 = nu->item1 < NUMBER_OF_ITEMS ? &items[nu->item1] : NULL;
+        u->item2 = nu->item2 < NUMBER_OF_ITEMS ? &items[nu->item2] : NULL;
+        place_unit(bf, u, nu->team, nu->x, nu->y);
+    }
+}
+
+static const char *net_error_text(int code) {
+    switch (code) {
+        case NET_ERR_PROTOCOL:       return "Protocol error";
+        case NET_ERR_NO_MATCH:       return "No such match";
+        case NET_ERR_POOL_FULL:      return "Server is full";
+        case NET_ERR_NOT_YOUR_TURN:  return "Not your turn!";
+        case NET_ERR_INVALID_ACTION: return "Invalid action!";
+        default:                     return "Server error";
+    }
+}
+
+int run_match_client(const char *socket_path, int match_id, int team,
+                     const UNIT a1[], int n1, const UNIT a2[], int n2,
+                     WINDOW *win)
+{
+    int wy, wx;
+    getmaxyx(win, wy, wx);
+
+    int fd = client_connect(socket_path);
+    if (fd < 0) {
+        mvwprintw(win, 1, 2, "Could not connect to %s. Press any key...", socket_path);
+        wrefresh(win);
+        wgetch(win);
+        return -1;
+    }
+
+    if (match_id == 0) {
+        match_id = create_match(fd, a1, n1, a2, n2);
+        team = JOIN_BOTH;
+        if (match_id == 0) {
+            mvwprintw(win, 1, 2, "Server refused the match. Press any key...");
+            wrefresh(win);
+            wgetch(win);
+            close(fd);
+            return -1;
+        }
+    }
+    uint8_t join = (uint8_t)team;
+    send_frame(fd, MSG_JOIN, (uint16_t)match_id, &join, 1);
+
+    scrollok(win, FALSE);
+    curs_set(0);
+    keypad(win, TRUE);
+    nodelay(win, TRUE);
+
+    Battlefield bf;
+    CombatLog log = {0};
+    init_battlefield(&bf);
+    bf.main_win = win;
+    bf.log = &log;
+    create_status_windows(&bf, wy, wx);
+    set_game_state(&bf, STATE_SELECT_UNIT);
+
+    UNIT units[2 * MAX_ARMY];
+    NetState st;
+    memset(&st, 0, sizeof st);
+    UNIT *selected_unit = NULL;
+    bool connected = true;
+
+    while (connected && st.winner == 0) {
+        struct pollfd fds[2] = {
+            {fd, POLLIN, 0},
+            {STDIN_FILENO, POLLIN, 0}
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // Server pushed something: a fresh snapshot or an error for our last action
+        if (fds[0].revents) {
+            MessageHeader hdr;
+            uint8_t payload[PROTO_MAX_PAYLOAD];
+            if (!recv_frame(fd, &hdr, payload)) {
+                connected = false;
+                break;
+            }
+            if (hdr.type == MSG_STATE && proto_decode_state(payload, hdr.len, &st)) {
+                apply_state(&bf, units, &st);
+                bf.has_selection = false;
+                selected_unit = NULL;
+                set_game_state(&bf, STATE_SELECT_UNIT);
+                update_all_displays(win, &bf, NULL);
+                display_combat_message(&bf, "%s | Player %d's turn", st.message, st.turn);
+            } else if (hdr.type == MSG_ERROR && hdr.len == 1) {
+                display_combat_message(&bf, "%s", net_error_text(payload[0]));
+            }
+        }
+
+        if (!(fds[1].revents & POLLIN)) continue;
+
+        int ch = wgetch(win);
+        if (ch == ERR) continue;
+        if (ch == 'q' || ch == 'Q') break;
+
+        bool update_needed = false;
+        switch (ch) {
+            case KEY_UP:    if (bf.cursor_pos.y > 0) { bf.cursor_pos.y--; update_needed = true; } break;
+            case KEY_DOWN:  if (bf.cursor_pos.y < MAX_GRID_HEIGHT-1) { bf.cursor_pos.y++; update_needed = true; } break;
+            case KEY_LEFT:  if (bf.cursor_pos.x > 0) { bf.cursor_pos.x--; update_needed = true; } break;
+            case KEY_RIGHT: if (bf.cursor_pos.x < MAX_GRID_WIDTH-1) { bf.cursor_pos.x++; update_needed = true; } break;
+            case 'l':
+            case 'L':       browse_combat_log(&bf); update_needed = true; break;
+
+            case 10: // Enter
+                if (bf.state == STATE_SELECT_UNIT) {
+                    const UnitSlot *slot = slot_at(&bf, bf.cursor_pos.x, bf.cursor_pos.y);
+                    if (!slot) break;
+                    bool mine = team == JOIN_BOTH ? slot->team == st.turn : slot->team == team;
+                    if (!mine) break;
+
+                    selected_unit = slot->unit;
+                    bf.has_selection = true;
+                    bf.selected_pos = bf.cursor_pos;
+                    set_game_state(&bf, STATE_SELECT_ACTION);
+
+                    ActionMenu menu;
+                    create_action_menu(&menu, wy, wx);
+                    nodelay(menu.win, FALSE);
+                    ActionType action = show_action_menu(&menu, selected_unit);
+                    destroy_action_menu(&menu);
+
+                    if (action == ACTION_MOVE) {
+                        set_game_state(&bf, STATE_MOVE_UNIT);
+                    } else if (action == ACTION_ATTACK) {
+                        set_game_state(&bf, STATE_SELECT_TARGET);
+                    } else if (action == ACTION_END_TURN) {
+                        send_action(fd, (uint16_t)match_id, NET_ACT_END_TURN, 0, 0, 0, 0);
+                    } else {
+                        bf.has_selection = false;
+                        selected_unit = NULL;
+                        set_game_state(&bf, STATE_SELECT_UNIT);
+                    }
+                    update_needed = true;
+                } else if (bf.state == STATE_MOVE_UNIT || bf.state == STATE_SELECT_TARGET) {
+                    // The server is authoritative; the next snapshot resets the selection
+                    send_action(fd, (uint16_t)match_id,
+                                bf.state == STATE_MOVE_UNIT ? NET_ACT_MOVE : NET_ACT_ATTACK,
+                                bf.selected_pos.x, bf.selected_pos.y,
+                                bf.cursor_pos.x, bf.cursor_pos.y);
+                }
+                break;
+
+            case 27: // Escape
+                bf.has_selection = false;
+                selected_unit = NULL;
+                set_game_state(&bf, STATE_SELECT_UNIT);
+                update_needed = true;
+                break;
+        }
+
+        if (update_needed) {
+            update_all_displays(win, &bf, selected_unit);
+        }
+    }
+
+    nodelay(win, FALSE);
+    if (st.winner) {
+        wattron(win, COLOR_PAIR(st.winner) | A_BOLD);
+        mvwprintw(win, wy/2, (wx-12)/2, "PLAYER %d WINS!", st.winner);
+        wattroff(win, COLOR_PAIR(st.winner) | A_BOLD);
+        display_combat_message(&bf, "Player %d is victorious!", st.winner);
+    } else if (!connected) {
+        display_combat_message(&bf, "Connection to server lost");
+    }
+    display_controls_hint(&bf, "Press any key to continue...");
+    wgetch(win);
+
+    destroy_status_windows(&bf);
+    close(fd);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Load test
+
+#define LOAD_TEST_MAX_ACTIONS 1000
+#define LOAD_TEST_STALL_JOINS 100000    // Joins a stalled client sends before giving up on a drop
+
+typedef struct {
+    int fd;
+    uint16_t match_id;
+    bool done;
+    int actions;
+} LoadClient;
+
+// Greedy policy for the load generator: attack if possible, else step closer
+static NetAction choose_action(const Battlefield *bf, int team) {
+    NetAction act = {NET_ACT_END_TURN, 0, 0, 0, 0};
+    int own = team - 1, enemy = 2 - team;
+
+    for (int i = 0; i < bf->unit_counts[own]; i++) {
+        const Position *p = &roster_slot(bf, own, i)->pos;
+        const UNIT *u = roster_slot(bf, own, i)->unit;
+        Bitboard targets = attack_targets(bf, u, p->x, p->y);
+        if (targets) {
+            int cell = bb_pop(&targets);
+            return (NetAction){NET_ACT_ATTACK, p->x, p->y,
+                               cell % MAX_GRID_WIDTH, cell / MAX_GRID_WIDTH};
+        }
+    }
+
+    for (int i = 0; i < bf->unit_counts[own]; i++) {
+        const Position *p = &roster_slot(bf, own, i)->pos;
+        const Position *e = &roster_slot(bf, enemy, 0)->pos;
+        int dx = (e->x > p->x) ? 1 : (e->x < p->x) ? -1 : 0;
+        int dy = (e->y > p->y) ? 1 : (e->y < p->y) ? -1 : 0;
+        if (dx && is_valid_move(bf, p->x, p->y, p->x + dx, p->y)) {
+            return (NetAction){NET_ACT_MOVE, p->x, p->y, p->x + dx, p->y};
+        }
+        if (dy && is_valid_move(bf, p->x, p->y, p->x, p->y + dy)) {
+            return (NetAction){NET_ACT_MOVE, p->x, p->y, p->x, p->y + dy};
+        }
+    }
+    return act;
+}
+
+static void default_armies(UNIT a1[], UNIT a2[]) {
+    for (int i = 0; i < MAX_ARMY; i++) {
+        memset(&a1[i], 0, sizeof a1[i]);
+        memset(&a2[i], 0, sizeof a2[i]);
+        snprintf(a1[i].name, sizeof a1[i].name, "Knight%d", i + 1);
+        snprintf(a2[i].name, sizeof a2[i].name, "Archer%d", i + 1);
+        a1[i].item1 = &items[0];   // Sword
+        a1[i].item2 = &items[1];   // Shield
+        a2[i].item1 = &items[2];   // Bow
+        a2[i].item2 = &items[6];   // Dagger
+        a1[i].hp = a2[i].hp = 100;
+    }
+}
+
+// A client that creates a match and then only writes. Every join is answered
+// with a full state it never reads, so the server has to drop it once its
+// output backs up, and give the match (which nobody else watches) back to
+// the pool. Returns true if it did.
+static bool stalled_client_dropped(const char *socket_path, const UNIT a1[], const UNIT a2[]) {
+    int fd = client_connect(socket_path);
+    uint16_t id = fd < 0 ? 0 : create_match(fd, a1, MAX_ARMY, a2, MAX_ARMY);
+    if (id == 0) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    uint8_t join = JOIN_SPECTATE;
+    int sent = 0;
+    while (sent < LOAD_TEST_STALL_JOINS && send_frame(fd, MSG_JOIN, id, &join, 1)) sent++;
+    close(fd);
+    if (sent == LOAD_TEST_STALL_JOINS) return false;
+
+    // The write failed because the server hung up; by then the match is freed
+    MessageHeader hdr;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    int probe = client_connect(socket_path);
+    bool freed = probe >= 0 && send_frame(probe, MSG_JOIN, id, &join, 1) &&
+                 recv_frame(probe, &hdr, payload) && hdr.type == MSG_ERROR &&
+                 hdr.len == 1 && payload[0] == NET_ERR_NO_MATCH;
+    if (probe >= 0) close(probe);
+    return freed;
+}
+
+int run_load_test(const char *socket_path, int matches) {
+    if (matches < 1) matches = 1;
+    LoadClient *clients = calloc(matches, sizeof(LoadClient));
+    struct pollfd *fds = calloc(matches, sizeof(struct pollfd));
+    if (!clients || !fds) {
+        free(clients);
+        free(fds);
+        return 1;
+    }
+
+    UNIT a1[MAX_ARMY], a2[MAX_ARMY];
+    default_armies(a1, a2);
+
+    bool stall_ok = stalled_client_dropped(socket_path, a1, a2);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int open_matches = 0;
+    for (int i = 0; i < matches; i++) {
+        LoadClient *c = &clients[i];
+        c->fd = client_connect(socket_path);
+        if (c->fd < 0 || (c->match_id = create_match(c->fd, a1, MAX_ARMY, a2, MAX_ARMY)) == 0) {
+            fprintf(stderr, "match %d: could not connect/create\n", i);
+            if (c->fd >= 0) close(c->fd);
+            c->fd = -1;
+            c->done = true;
+            continue;
+        }
+        uint8_t join = JOIN_BOTH;
+        send_frame(c->fd, MSG_JOIN, c->match_id, &join, 1);
+        open_matches++;
+    }
+
+    Battlefield bf;
+    UNIT units[2 * MAX_ARMY];
+    int finished = 0, failed = 0;
+    long total_actions = 0;
+
+    while (finished + failed < open_matches) {
+        for (int i = 0; i < matches; i++) {
+            fds[i].fd = clients[i].done ? -1 : clients[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        if (poll(fds, matches, 5000) <= 0) break;
+
+        for (int i = 0; i < matches; i++) {
+            LoadClient *c = &clients[i];
+            if (c->done || !fds[i].revents) continue;
+
+            MessageHeader hdr;
+            uint8_t payload[PROTO_MAX_PAYLOAD];
+            NetState st;
+            if (!recv_frame(c->fd, &hdr, payload) || hdr.type != MSG_STATE ||
+                !proto_decode_state(payload, hdr.len, &st)) {
+                c->done = true;
+                failed++;
+                continue;
+            }
+            if (st.winner || c->actions >= LOAD_TEST_MAX_ACTIONS) {
+                // Stalemated matches are abandoned rather than played forever
+                c->done = true;
+                finished++;
+                continue;
+            }
+
+            init_battlefield(&bf);
+            apply_state(&bf, units, &st);
+            NetAction act = choose_action(&bf, st.turn);
+            send_action(c->fd, c->match_id, act.kind, act.from_x, act.from_y, act.to_x, act.to_y);
+            c->actions++;
+            total_actions++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("Load test: %d matches, %d finished, %d failed\n", matches, finished, failed);
+    printf("%ld actions in %.3f s (%.0f actions/s)\n",
+           total_actions, secs, secs > 0 ? total_actions / secs : 0.0);
+    printf("Stalled client: %s\n", stall_ok ? "dropped, match freed" : "not dropped");
+
+    for (int i = 0; i < matches; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    free(clients);
+    free(fds);
+    return failed || !stall_ok ? 1 : 0;
+}
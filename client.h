@@ -0,0 +1,17 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <ncurses.h>
+#include "data.h"
+
+// Thin ncurses client for the match server. With match_id == 0 a new match is
+// created from the given armies and played hot-seat (both teams); otherwise the
+// client attaches to an existing match as `team` (1, 2, JOIN_BOTH or JOIN_SPECTATE).
+int run_match_client(const char *socket_path, int match_id, int team,
+                     const UNIT a1[], int n1, const UNIT a2[], int n2,
+                     WINDOW *win);
+
+// Headless load generator: plays `matches` games concurrently against the server
+int run_load_test(const char *socket_path, int matches);
+
+#endif // CLIENT_H
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+#include "combatlog.h"
+
+#define SPEC_MAX 16     // Longest conversion spec kept, "%-10d" and the like
+
+// Length of the conversion spec starting at the '%' in `p`, and its
+// conversion letter in *conv; 0 for specs the log can't store
+static size_t spec_length(const char *p, char *conv) {
+    size_t n = 1;
+    while (p[n] && strchr("-+ #0", p[n])) n++;
+    while (p[n] >= '0' && p[n] <= '9') n++;
+    if (p[n] == '.') {
+        n++;
+        while (p[n] >= '0' && p[n] <= '9') n++;
+    }
+    if (!p[n] || !strchr("diuxcs%", p[n]) || n + 1 >= SPEC_MAX) return 0;
+    *conv = p[n];
+    return n + 1;
+}
+
+static CombatLogRecord *next_record(CombatLog *log) {
+    return &log->records[log->count++ & (COMBAT_LOG_RECORDS - 1)];
+}
+
+void combat_log_add(CombatLog *log, const char *format, va_list args) {
+    CombatLogRecord *rec = next_record(log);
+    va_list fallback;
+    va_copy(fallback, args);
+
+    size_t used = 0;
+    int nargs = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%') continue;
+        char conv;
+        size_t n = spec_length(p, &conv);
+        if (n == 0 || (conv != '%' && nargs == COMBAT_LOG_ARGS)) {
+            // Nothing to replay it from later; keep the text instead
+            vsnprintf(rec->text, sizeof(rec->text), format, fallback);
+            rec->format = NULL;
+            va_end(fallback);
+            return;
+        }
+        if (conv == 's') {
+            // Copy the string, since names may be gone by the time it is shown,
+            // and cut short when the record runs out of room
+            const char *s = va_arg(args, const char *);
+            size_t len = s ? strnlen(s, sizeof(rec->text) - 1 - used) : 0;
+            if (len) memcpy(rec->text + used, s, len);
+            rec->text[used + len] = '\0';
+            rec->args[nargs++] = (int32_t)used;
+            used += len + 1;
+            if (used > sizeof(rec->text) - 1) used = sizeof(rec->text) - 1;  // Later ones share the last '\0'
+        } else if (conv != '%') {
+            rec->args[nargs++] = va_arg(args, int);
+        }
+        p += n - 1;
+    }
+    rec->format = format;
+    va_end(fallback);
+}
+
+int combat_log_size(const CombatLog *log) {
+    return log->count < COMBAT_LOG_RECORDS ? (int)log->count : COMBAT_LOG_RECORDS;
+}
+
+bool combat_log_format(const CombatLog *log, int back, char *buf, size_t size) {
+    if (size == 0 || back < 0 || back >= combat_log_size(log)) return false;
+    const CombatLogRecord *rec = &log->records[(log->count - 1 - (uint32_t)back) &
+                                               (COMBAT_LOG_RECORDS - 1)];
+    if (!rec->format) {
+        snprintf(buf, size, "%s", rec->text);
+        return true;
+    }
+
+    // Replay the format one conversion at a time
+    size_t len = 0;
+    int arg = 0;
+    const char *p = rec->format;
+    while (*p && len + 1 < size) {
+        if (*p != '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+        char conv, spec[SPEC_MAX];
+        size_t n = spec_length(p, &conv);
+        memcpy(spec, p, n);
+        spec[n] = '\0';
+        p += n;
+
+        int written;
+        if (conv == '%') written = snprintf(buf + len, size - len, "%%");
+        else if (conv == 's') written = snprintf(buf + len, size - len, spec, rec->text + rec->args[arg++]);
+        else written = snprintf(buf + len, size - len, spec, rec->args[arg++]);
+        if (written < 0) break;
+        len += (size_t)written < size - len ? (size_t)written : size - len - 1;
+    }
+    buf[len] = '\0';
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef COMBATLOG_H
+#define COMBATLOG_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Scrollback of the combat messages. Each message is kept as its format and
+// arguments in a fixed ring, so a long session holds no more than a short
+// one, and the text is only put together when the message is on screen.
+#define COMBAT_LOG_RECORDS 256      // A power of two; the oldest are overwritten
+#define COMBAT_LOG_ARGS 6           // Conversions a format may have
+#define COMBAT_LOG_TEXT 96          // Bytes for the string arguments of one message
+
+typedef struct {
+    const char *format;             // NULL when `text` holds the formatted message
+    int32_t args[COMBAT_LOG_ARGS];  // %d/%u/%x/%c values, or offsets into text for %s
+    char text[COMBAT_LOG_TEXT];
+} CombatLogRecord;
+
+// A zeroed log is empty
+typedef struct {
+    CombatLogRecord records[COMBAT_LOG_RECORDS];
+    uint32_t count;                 // Messages ever added
+} CombatLog;
+
+// Formats must outlive the log (string literals): only the pointer is
+// stored. Those with other conversions, or too many, are formatted at once.
+void combat_log_add(CombatLog *log, const char *format, va_list args);
+
+// Messages the ring still holds
+int combat_log_size(const CombatLog *log);
+
+// Writes the message `back` places before the newest (0 = the newest) into
+// buf; false if the ring no longer holds it
+bool combat_log_format(const CombatLog *log, int back, char *buf, size_t size);
+
+#endif // COMBATLOG_H
@@ -6,6 +6,15 @@
 #define MIN_ARMY 1
 #define MAX_ARMY 5
 
+// Lasting effects an item leaves behind
+typedef enum {
+    EFFECT_NONE,
+    EFFECT_FREEZE,  // Blast victims can't act
+    EFFECT_BURN,    // Blast victims lose hp every round
+    EFFECT_SHIELD,  // A bearer who ends the turn without acting takes less damage
+    EFFECT_COUNT
+} EffectType;
+
 typedef struct item {
     char name[MAX_NAME + 1];
     int att;
@@ -13,6 +22,10 @@ typedef struct item {
     int slots;
     int range;
     int radius;
+    int weight;         // Slows the bearer down, see unit_delay
+    int effect;         // EffectType
+    int effect_rounds;  // How long the effect lasts
+    int effect_power;   // Burn damage per round, or share of damage a shield stops (%)
 } ITEM;
 
 typedef struct unit {
@@ -24,6 +37,9 @@ typedef struct unit {
 
 extern const ITEM items[NUMBER_OF_ITEMS];
 
+// Position of an item in the catalog, or -1 for NULL/unknown items
+int item_index(const ITEM *it);
+
 #endif
 
 
@@ -0,0 +1,33 @@
+#include <string.h>
+#include "density.h"
+
+void density_init(DensityPyramid *p, int width, int height) {
+    memset(p, 0, sizeof(*p));
+    int offset = 0;
+    for (int level = 0; level < DENSITY_MAX_LEVELS; level++) {
+        p->width[level] = width;
+        p->height[level] = height;
+        p->offset[level] = offset;
+        p->levels = level + 1;
+        offset += width * height;
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+void density_add(DensityPyramid *p, int team, int x, int y, int count, int hp) {
+    int t = team - 1;
+    for (int level = 0; level < p->levels; level++) {
+        DensityCell *cell = &p->cells[p->offset[level] + (y >> level) * p->width[level] + (x >> level)];
+        cell->count[t] += count;
+        cell->hp[t] += hp;
+    }
+}
+
+int density_level_for(const DensityPyramid *p, int max_width, int max_height) {
+    for (int level = 0; level < p->levels; level++) {
+        if (p->width[level] <= max_width && p->height[level] <= max_height) return level;
+    }
+    return p->levels - 1;
+}
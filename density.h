@@ -0,0 +1,42 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <stdint.h>
+
+// Largest board the pyramid can hold, and the levels that takes: 16x16,
+// 8x8, 4x4, 2x2 and 1x1
+#define DENSITY_MAX_SIDE 16
+#define DENSITY_MAX_LEVELS 5
+#define DENSITY_MAX_CELLS (16 * 16 + 8 * 8 + 4 * 4 + 2 * 2 + 1)
+
+// Units of each team inside one pyramid cell, and their summed hp
+typedef struct {
+    uint8_t count[2];
+    int16_t hp[2];
+} DensityCell;
+
+// Mip pyramid of unit density. Level 0 is the board itself; every level
+// above sums 2x2 blocks of the one below, up to a single cell for the
+// whole board. A change on the board touches one cell per level, and
+// reading any level costs one lookup per cell read.
+typedef struct {
+    int levels;
+    int width[DENSITY_MAX_LEVELS];
+    int height[DENSITY_MAX_LEVELS];
+    int offset[DENSITY_MAX_LEVELS];     // First cell of each level in cells[]
+    DensityCell cells[DENSITY_MAX_CELLS];
+} DensityPyramid;
+
+// Empties the pyramid for a board of the given size
+void density_init(DensityPyramid *p, int width, int height);
+// Adds count units and hp to board cell (x, y) for team 1 or 2; negative
+// values take them away
+void density_add(DensityPyramid *p, int team, int x, int y, int count, int hp);
+// Finest level that fits in max_width x max_height cells
+int density_level_for(const DensityPyramid *p, int max_width, int max_height);
+
+static inline const DensityCell *density_cell(const DensityPyramid *p, int level, int x, int y) {
+    return &p->cells[p->offset[level] + y * p->width[level] + x];
+}
+
+#endif // DENSITY_H
@@ -0,0 +1,188 @@
+#include <string.h>
+#include "battlefield.h"
+
+void effects_reset(EffectWheel *wheel) {
+    memset(wheel, 0, sizeof(*wheel));
+    memset(wheel->heads, NO_TIMER, sizeof(wheel->heads));
+    for (int id = 0; id < EFFECT_TIMERS; id++) {
+        EffectTimer *t = &wheel->timers[id];
+        t->next = t->prev = t->bucket = NO_TIMER;
+    }
+}
+
+static void unlink_timer(EffectWheel *wheel, int id) {
+    EffectTimer *t = &wheel->timers[id];
+    if (t->bucket == NO_TIMER) return;
+
+    int8_t *head = &wheel->heads[t->bucket / WHEEL_SLOTS][t->bucket % WHEEL_SLOTS];
+    if (t->prev != NO_TIMER) wheel->timers[t->prev].next = t->next;
+    else *head = t->next;
+    if (t->next != NO_TIMER) wheel->timers[t->next].prev = t->prev;
+    t->next = t->prev = t->bucket = NO_TIMER;
+}
+
+// Files the timer under its due tick: level 0 when it fires within the
+// current 16 ticks' reach, otherwise the level 1 bucket of its span
+static void link_timer(EffectWheel *wheel, int id) {
+    EffectTimer *t = &wheel->timers[id];
+    uint16_t delay = (uint16_t)(t->due - wheel->now);
+    int bucket = delay < WHEEL_SLOTS ? t->due % WHEEL_SLOTS
+                                     : WHEEL_SLOTS + (t->due / WHEEL_SLOTS) % WHEEL_SLOTS;
+
+    int8_t *head = &wheel->heads[bucket / WHEEL_SLOTS][bucket % WHEEL_SLOTS];
+    t->bucket = (int8_t)bucket;
+    t->prev = NO_TIMER;
+    t->next = *head;
+    if (*head != NO_TIMER) wheel->timers[*head].prev = (int8_t)id;
+    *head = (int8_t)id;
+}
+
+static void schedule(EffectWheel *wheel, int id, int delay) {
+    if (delay < 1) delay = 1;
+    if (delay > WHEEL_SPAN - 1) delay = WHEEL_SPAN - 1;
+    unlink_timer(wheel, id);
+    wheel->timers[id].due = (uint16_t)(wheel->now + delay);
+    link_timer(wheel, id);
+}
+
+static int timer_id(int slot, EffectType type) {
+    return slot * EFFECT_TYPES + type - 1;
+}
+
+// Puts the item's effect on the unit in `slot`, replacing any it already has
+// of that type. Burns fire every round; freeze and shield once, at the end.
+void apply_effect(Battlefield *bf, int slot, const ITEM *item) {
+    if (!item || item->effect == EFFECT_NONE || item->effect_rounds <= 0) return;
+
+    int id = timer_id(slot, item->effect);
+    EffectTimer *t = &bf->effects.timers[id];
+    t->power = (uint8_t)item->effect_power;
+    if (item->effect == EFFECT_BURN) {
+        t->left = (uint8_t)item->effect_rounds;
+        schedule(&bf->effects, id, TICKS_PER_ROUND);
+    } else {
+        t->left = 1;
+        schedule(&bf->effects, id, item->effect_rounds * TICKS_PER_ROUND);
+    }
+}
+
+// A unit that ends its turn without acting raises its shield, if it has one
+bool brace_unit(Battlefield *bf, int slot) {
+    const UNIT *unit = bf->slots[slot].unit;
+    if (!unit || has_effect(bf, slot, EFFECT_FREEZE)) return false;
+
+    const ITEM *held[2] = { unit->item1, unit->item2 };
+    for (int i = 0; i < 2; i++) {
+        if (held[i] && held[i]->effect == EFFECT_SHIELD) {
+            apply_effect(bf, slot, held[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drops every effect on the slot, called when its unit leaves the board
+void clear_effects(Battlefield *bf, int slot) {
+    for (int type = 1; type < EFFECT_COUNT; type++) {
+        int id = timer_id(slot, type);
+        unlink_timer(&bf->effects, id);
+        bf->effects.timers[id].left = 0;
+    }
+}
+
+static void fire_timer(Battlefield *bf, int id, EffectReport *report) {
+    EffectTimer *t = &bf->effects.timers[id];
+    if (t->left == 0) return;   // A burn earlier in this tick took the unit down
+
+    int slot = id / EFFECT_TYPES;
+    if (id % EFFECT_TYPES + 1 == EFFECT_BURN) {
+        const UnitSlot *s = &bf->slots[slot];
+        int team = s->team;
+        report->burns++;
+        report->damage += t->power;
+        damage_unit(bf, s->pos.x, s->pos.y, t->power);
+        if (s->unit->hp <= 0) {
+            remove_unit(bf, s->pos.x, s->pos.y);  // Clears this timer too
+            report->defeated[team - 1]++;
+            return;
+        }
+    }
+    if (--t->left > 0) schedule(&bf->effects, id, TICKS_PER_ROUND);
+}
+
+// Advances the clock one tick and fires whatever is due on it
+void effects_tick(Battlefield *bf, EffectReport *report) {
+    EffectWheel *wheel = &bf->effects;
+    memset(report, 0, sizeof(*report));
+    wheel->now++;
+
+    // Entering a new span: spread its level 1 bucket over level 0
+    if (wheel->now % WHEEL_SLOTS == 0) {
+        int8_t *head = &wheel->heads[1][(wheel->now / WHEEL_SLOTS) % WHEEL_SLOTS];
+        int id = *head;
+        *head = NO_TIMER;
+        while (id != NO_TIMER) {
+            int next = wheel->timers[id].next;
+            link_timer(wheel, id);
+            id = next;
+        }
+    }
+
+    // Detach the due bucket first: firing can reschedule or clear timers
+    int8_t *head = &wheel->heads[0][wheel->now % WHEEL_SLOTS];
+    int due[EFFECT_TIMERS], count = 0;
+    for (int id = *head; id != NO_TIMER; id = wheel->timers[id].next) due[count++] = id;
+    *head = NO_TIMER;
+    for (int i = 0; i < count; i++) {
+        EffectTimer *t = &wheel->timers[due[i]];
+        t->next = t->prev = t->bucket = NO_TIMER;
+    }
+
+    // Lowest slot first, so the outcome doesn't depend on bucket order
+    for (int i = 1; i < count; i++) {
+        int id = due[i], j = i - 1;
+        while (j >= 0 && due[j] > id) {
+            due[j + 1] = due[j];
+            j--;
+        }
+        due[j + 1] = id;
+    }
+    for (int i = 0; i < count; i++) fire_timer(bf, due[i], report);
+}
+
+void get_unit_effects(const Battlefield *bf, int slot, UnitEffects *out) {
+    const EffectWheel *wheel = &bf->effects;
+    for (int type = 1; type < EFFECT_COUNT; type++) {
+        const EffectTimer *t = &wheel->timers[timer_id(slot, type)];
+        EffectState *s = &out->of[type - 1];
+        bool active = t->left > 0 && t->bucket != NO_TIMER;
+        s->wait = active ? (uint8_t)(uint16_t)(t->due - wheel->now) : 0;
+        s->left = active ? t->left : 0;
+        s->power = active ? t->power : 0;
+    }
+}
+
+void set_unit_effects(Battlefield *bf, int slot, const UnitEffects *fx) {
+    clear_effects(bf, slot);
+    for (int type = 1; type < EFFECT_COUNT; type++) {
+        const EffectState *s = &fx->of[type - 1];
+        if (s->wait == 0 || s->left == 0) continue;
+        int id = timer_id(slot, type);
+        bf->effects.timers[id].left = s->left;
+        bf->effects.timers[id].power = s->power;
+        schedule(&bf->effects, id, s->wait);
+    }
+}
+
+// Damage an attack from `attacker` does to the unit at (x, y), less what
+// a raised shield stops
+int attack_damage(const Battlefield *bf, const UNIT *attacker, int x, int y) {
+    const UnitSlot *slot = slot_at(bf, x, y);
+    int damage = calculate_damage(attacker, slot->unit);
+    int idx = (int)(slot - bf->slots);
+    if (has_effect(bf, idx, EFFECT_SHIELD)) {
+        damage -= damage * bf->effects.timers[timer_id(idx, EFFECT_SHIELD)].power / 100;
+        if (damage < 1) damage = 1;
+    }
+    return damage;
+}
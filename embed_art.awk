@@ -0,0 +1,70 @@
+# Turns the menu art files into C data for art_data.c. Run in the C locale so
+# lengths are in bytes:  LC_ALL=C awk -f embed_art.awk title.txt ...
+#
+# Lines get the same clean-up the game applies when reading the files itself
+# (trailing CR dropped, U+2800 braille blanks turned into spaces), and each
+# asset records its width in screen columns.
+
+function flush_file(    i) {
+    if (name == "") return
+    printf "static const char *const art_%d_lines[] = {\n", count
+    if (height == 0) printf "    NULL\n"
+    for (i = 0; i < height; i++) printf "    \"%s\",\n", lines[i]
+    printf "};\n\n"
+    names[count] = name
+    widths[count] = width
+    heights[count] = height
+    count++
+}
+
+# Backslashes and quotes escaped for a C string literal
+function c_escape(s,    out, c, i) {
+    out = ""
+    for (i = 1; i <= length(s); i++) {
+        c = substr(s, i, 1)
+        if (c == "\\" || c == "\"") out = out "\\"
+        out = out c
+    }
+    return out
+}
+
+BEGIN {
+    count = 0
+    print "// Generated from the menu art files by embed_art.awk. Do not edit."
+    print "#include <stddef.h>"
+    print "#include \"art.h\""
+    print ""
+}
+
+FNR == 1 {
+    flush_file()
+    name = FILENAME
+    sub(/.*\//, "", name)
+    height = 0
+    width = 0
+}
+
+{
+    line = $0
+    sub(/\r$/, "", line)
+    gsub(/\342\240\200/, " ", line)
+
+    # Screen width: every byte that doesn't continue a UTF-8 sequence
+    tmp = line
+    columns = length(line) - gsub(/[\200-\277]/, "", tmp)
+    if (columns > width) width = columns
+
+    lines[height++] = c_escape(line)
+}
+
+END {
+    flush_file()
+    print "const ArtAsset art_assets[] = {"
+    for (i = 0; i < count; i++) {
+        printf "    {\"%s\", %d, %d, art_%d_lines},\n", names[i], widths[i], heights[i], i
+    }
+    if (count == 0) print "    {NULL, 0, 0, NULL},"
+    print "};"
+    print ""
+    printf "const int art_asset_count = %d;\n", count
+}
@@ -0,0 +1,391 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "eventlog.h"
+#include "trace.h"
+
+// File layout, in host byte order:
+//   header: "BAEV", uint16 version, uint16 columns, uint16 catalog size
+//   blocks: uint32 payload bytes, uint32 rows, then per column a uint32
+//           base, a uint8 bit width and the values minus base, packed
+//           LSB first. The payload ends in 8 zero bytes so readers can
+//           always load a whole uint64.
+#define EVENT_MAGIC "BAEV"
+#define EVENT_VERSION 1
+#define EVENT_PAD 8
+
+typedef struct EventBlock {
+    uint32_t cols[EVENT_COLUMNS][EVENT_BLOCK_ROWS];
+    int rows;
+    struct EventBlock *next;
+} EventBlock;
+
+bool eventlog_on = false;
+
+static FILE *out;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t has_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t has_room = PTHREAD_COND_INITIALIZER;
+static EventBlock *full_head, *full_tail, *spare;
+static int queued;
+static bool closing;
+static bool write_failed;
+static EventBlock *open_blocks[EVENT_MAX_THREADS];  // Each thread's block being filled
+static int thread_count;
+static __thread int thread_slot = -1;
+static __thread bool thread_unlogged;
+
+// Caller holds the lock
+static EventBlock *new_block(void) {
+    EventBlock *b = spare;
+    if (b) spare = b->next;
+    else b = malloc(sizeof(EventBlock));
+    if (b) {
+        b->rows = 0;
+        b->next = NULL;
+    }
+    return b;
+}
+
+// Caller holds the lock
+static void enqueue(EventBlock *b) {
+    if (full_tail) full_tail->next = b;
+    else full_head = b;
+    full_tail = b;
+    queued++;
+    pthread_cond_signal(&has_full);
+}
+
+static size_t pack_column(uint8_t *dst, const uint32_t *v, int rows) {
+    uint32_t lo = v[0], hi = v[0];
+    for (int i = 1; i < rows; i++) {
+        if (v[i] < lo) lo = v[i];
+        if (v[i] > hi) hi = v[i];
+    }
+    uint8_t bits = hi == lo ? 0 : (uint8_t)(32 - __builtin_clz(hi - lo));
+    memcpy(dst, &lo, 4);
+    dst[4] = bits;
+
+    size_t n = 5;
+    uint64_t acc = 0;
+    int filled = 0;
+    for (int i = 0; i < rows && bits; i++) {
+        acc |= (uint64_t)(v[i] - lo) << filled;
+        filled += bits;
+        while (filled >= 8) {
+            dst[n++] = (uint8_t)acc;
+            acc >>= 8;
+            filled -= 8;
+        }
+    }
+    if (filled > 0) dst[n++] = (uint8_t)acc;
+    return n;
+}
+
+static void write_block(const EventBlock *b, uint8_t *buf) {
+    size_t n = 8;
+    for (int c = 0; c < EVENT_COLUMNS; c++) n += pack_column(buf + n, b->cols[c], b->rows);
+    memset(buf + n, 0, EVENT_PAD);
+    n += EVENT_PAD;
+
+    uint32_t payload = (uint32_t)(n - 4), rows = (uint32_t)b->rows;
+    memcpy(buf, &payload, 4);
+    memcpy(buf + 4, &rows, 4);
+    if (fwrite(buf, 1, n, out) != n) write_failed = true;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    trace_thread_name("event writer");
+    uint8_t *buf = malloc(8 + EVENT_COLUMNS * (5 + 4 * (size_t)EVENT_BLOCK_ROWS) + EVENT_PAD);
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (!full_head && !closing) pthread_cond_wait(&has_full, &lock);
+        EventBlock *b = full_head;
+        if (!b) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        full_head = b->next;
+        if (!full_head) full_tail = NULL;
+        pthread_mutex_unlock(&lock);
+
+        if (buf) {
+            TRACE_SCOPE("event_block");
+            write_block(b, buf);
+        } else {
+            write_failed = true;
+        }
+
+        pthread_mutex_lock(&lock);
+        b->next = spare;
+        spare = b;
+        queued--;
+        pthread_cond_broadcast(&has_room);
+        pthread_mutex_unlock(&lock);
+    }
+    free(buf);
+    return NULL;
+}
+
+// The calling thread's block, registered on its first event
+static EventBlock *thread_block(void) {
+    if (thread_slot >= 0) return open_blocks[thread_slot];
+    if (thread_unlogged) return NULL;
+
+    pthread_mutex_lock(&lock);
+    EventBlock *b = thread_count < EVENT_MAX_THREADS && !closing ? new_block() : NULL;
+    if (b) {
+        thread_slot = thread_count++;
+        open_blocks[thread_slot] = b;
+    }
+    pthread_mutex_unlock(&lock);
+    thread_unlogged = !b;
+    return b;
+}
+
+void eventlog_append(const uint32_t row[EVENT_COLUMNS]) {
+    EventBlock *b = thread_block();
+    if (!b) return;
+    for (int c = 0; c < EVENT_COLUMNS; c++) b->cols[c][b->rows] = row[c];
+    if (++b->rows < EVENT_BLOCK_ROWS) return;
+
+    // Hand the block over, waiting while the writer is behind
+    pthread_mutex_lock(&lock);
+    while (queued >= EVENT_QUEUE_BLOCKS && !closing) pthread_cond_wait(&has_room, &lock);
+    enqueue(b);
+    b = new_block();
+    open_blocks[thread_slot] = b;
+    pthread_mutex_unlock(&lock);
+    if (!b) {
+        thread_slot = -1;
+        thread_unlogged = true;
+    }
+}
+
+static void finish_at_exit(void) {
+    eventlog_finish();
+}
+
+bool eventlog_start(const char *path) {
+    if (out) return false;
+    out = fopen(path, "wb");
+    if (!out) return false;
+
+    uint16_t meta[3] = {EVENT_VERSION, EVENT_COLUMNS, NUMBER_OF_ITEMS};
+    fwrite(EVENT_MAGIC, 1, 4, out);
+    fwrite(meta, sizeof(meta), 1, out);
+    if (pthread_create(&writer, NULL, writer_main, NULL) != 0) {
+        fclose(out);
+        out = NULL;
+        return false;
+    }
+    eventlog_on = true;
+    return atexit(finish_at_exit) == 0;
+}
+
+// Threads that logged must be done by now; their partly filled blocks go last
+void eventlog_finish(void) {
+    if (!out) return;
+    eventlog_on = false;
+
+    pthread_mutex_lock(&lock);
+    for (int t = 0; t < thread_count; t++) {
+        EventBlock *b = open_blocks[t];
+        open_blocks[t] = NULL;
+        if (!b) continue;
+        if (b->rows > 0) enqueue(b);
+        else free(b);
+    }
+    closing = true;
+    pthread_cond_broadcast(&has_full);
+    pthread_mutex_unlock(&lock);
+    pthread_join(writer, NULL);
+
+    while (spare) {
+        EventBlock *b = spare;
+        spare = b->next;
+        free(b);
+    }
+    if (fclose(out) != 0 || write_failed) fprintf(stderr, "Event log is incomplete\n");
+    out = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Query
+
+typedef struct {
+    uint64_t hits, damage, kills;       // As the attacker
+    uint64_t taken, damage_taken, deaths;
+} ItemTotals;
+
+typedef struct {
+    uint64_t hits, damage, kills;
+} Matchup;
+
+#define EVENT_ITEMS (NUMBER_OF_ITEMS + 1)   // The catalog plus the empty hand
+
+// Unpacks one column of `rows` values; NULL if it runs past `end`
+static const uint8_t *unpack_column(const uint8_t *p, const uint8_t *end, int rows, uint32_t *v) {
+    if (end - p < 5) return NULL;
+    uint32_t base;
+    memcpy(&base, p, 4);
+    int bits = p[4];
+    p += 5;
+    if (bits > 32) return NULL;
+
+    size_t bytes = ((size_t)rows * bits + 7) / 8;
+    if ((size_t)(end - p) < bytes) return NULL;
+    if (bits == 0) {
+        for (int i = 0; i < rows; i++) v[i] = base;
+        return p;
+    }
+
+    // Every value sits inside one unaligned uint64 load; the block's
+    // padding keeps the last load inside the file
+    uint64_t mask = bits == 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+    for (int i = 0; i < rows; i++) {
+        size_t bit = (size_t)i * bits;
+        uint64_t word;
+        memcpy(&word, p + (bit >> 3), 8);
+        v[i] = base + (uint32_t)((word >> (bit & 7)) & mask);
+    }
+    return p + bytes;
+}
+
+static const char *item_label(int id) {
+    return id < NUMBER_OF_ITEMS ? items[id].name : "(empty hand)";
+}
+
+int run_event_query(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < 10) {
+        fprintf(stderr, "Can't read events from %s\n", path);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Can't map %s\n", path);
+        return 1;
+    }
+
+    uint16_t meta[3];
+    memcpy(meta, data + 4, sizeof(meta));
+    if (memcmp(data, EVENT_MAGIC, 4) != 0 || meta[0] != EVENT_VERSION ||
+        meta[1] != EVENT_COLUMNS || meta[2] != NUMBER_OF_ITEMS) {
+        fprintf(stderr, "%s is not an event log of this version\n", path);
+        munmap((void *)data, size);
+        return 1;
+    }
+
+    static uint32_t cols[EVENT_COLUMNS][EVENT_BLOCK_ROWS];
+    static ItemTotals item[EVENT_ITEMS];
+    static Matchup matchup[EVENT_ITEMS][EVENT_ITEMS];
+    memset(item, 0, sizeof(item));
+    memset(matchup, 0, sizeof(matchup));
+    uint64_t events = 0, blocks = 0, distance = 0, damage = 0, kills = 0;
+    uint32_t last_round = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    const uint8_t *p = data + 10, *end = data + size;
+    bool damaged = false;
+    while (p < end) {
+        uint32_t payload, rows;
+        if (end - p < 8) { damaged = true; break; }
+        memcpy(&payload, p, 4);
+        memcpy(&rows, p + 4, 4);
+        const uint8_t *block_end = p + 4 + payload;
+        if (payload > (size_t)(end - p) - 4 || payload < 4 + EVENT_PAD || rows == 0 ||
+            rows > EVENT_BLOCK_ROWS) { damaged = true; break; }
+
+        const uint8_t *q = p + 8;
+        for (int c = 0; c < EVENT_COLUMNS && q; c++) {
+            q = unpack_column(q, block_end - EVENT_PAD, (int)rows, cols[c]);
+        }
+        if (!q) { damaged = true; break; }
+
+        for (uint32_t r = 0; r < rows; r++) {
+            uint32_t a[2] = {cols[EV_ATTACKER_ITEM1][r], cols[EV_ATTACKER_ITEM2][r]};
+            uint32_t t[2] = {cols[EV_TARGET_ITEM1][r], cols[EV_TARGET_ITEM2][r]};
+            uint32_t dmg = cols[EV_DAMAGE][r], kill = cols[EV_KILL][r] != 0;
+            for (int k = 0; k < 2; k++) {
+                if (a[k] > EVENT_NO_ITEM) a[k] = EVENT_NO_ITEM;
+                if (t[k] > EVENT_NO_ITEM) t[k] = EVENT_NO_ITEM;
+            }
+            int na = a[1] == a[0] ? 1 : 2, nt = t[1] == t[0] ? 1 : 2;  // Two of a kind count once
+
+            for (int i = 0; i < na; i++) {
+                item[a[i]].hits++;
+                item[a[i]].damage += dmg;
+                item[a[i]].kills += kill;
+                for (int j = 0; j < nt; j++) {
+                    Matchup *m = &matchup[a[i]][t[j]];
+                    m->hits++;
+                    m->damage += dmg;
+                    m->kills += kill;
+                }
+            }
+            for (int j = 0; j < nt; j++) {
+                item[t[j]].taken++;
+                item[t[j]].damage_taken += dmg;
+                item[t[j]].deaths += kill;
+            }
+            distance += cols[EV_DISTANCE][r];
+            damage += dmg;
+            kills += kill;
+            if (cols[EV_ROUND][r] > last_round) last_round = cols[EV_ROUND][r];
+        }
+        events += rows;
+        blocks++;
+        p = block_end;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    munmap((void *)data, size);
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("Events: %s, %llu hits in %llu blocks, %.1f MB (%.1f bytes a hit)\n", path,
+           (unsigned long long)events, (unsigned long long)blocks, (double)size / 1e6,
+           events ? (double)size / (double)events : 0.0);
+    printf("Scanned in %.1f ms (%.0f M hits/s)%s\n", secs * 1e3,
+           secs > 0 ? (double)events / secs / 1e6 : 0.0, damaged ? ", stopped at a damaged block" : "");
+    if (events == 0) return damaged ? 1 : 0;
+    printf("Total damage %llu, %llu kills, mean distance %.2f, longest battle %u rounds\n\n",
+           (unsigned long long)damage, (unsigned long long)kills,
+           (double)distance / (double)events, last_round);
+
+    printf("%-16s %10s %8s %6s   %10s %8s %6s\n",
+           "Item", "Hits", "Dmg/hit", "Kill%", "Hit", "Dmg/hit", "Died%");
+    for (int i = 0; i < EVENT_ITEMS; i++) {
+        const ItemTotals *it = &item[i];
+        if (!it->hits && !it->taken) continue;
+        printf("%-16s %10llu %8.2f %5.1f%%   %10llu %8.2f %5.1f%%\n", item_label(i),
+               (unsigned long long)it->hits, it->hits ? (double)it->damage / (double)it->hits : 0.0,
+               it->hits ? 100.0 * (double)it->kills / (double)it->hits : 0.0,
+               (unsigned long long)it->taken, it->taken ? (double)it->damage_taken / (double)it->taken : 0.0,
+               it->taken ? 100.0 * (double)it->deaths / (double)it->taken : 0.0);
+    }
+
+    printf("\n%-16s %-16s %10s %8s %6s\n", "Attacker item", "Target item", "Hits", "Dmg/hit", "Kill%");
+    for (int a = 0; a < EVENT_ITEMS; a++) {
+        for (int t = 0; t < EVENT_ITEMS; t++) {
+            const Matchup *m = &matchup[a][t];
+            if (!m->hits) continue;
+            printf("%-16s %-16s %10llu %8.2f %5.1f%%\n", item_label(a), item_label(t),
+                   (unsigned long long)m->hits, (double)m->damage / (double)m->hits,
+                   100.0 * (double)m->kills / (double)m->hits);
+        }
+    }
+    return damaged ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "data.h"
+
+// Combat events for analysis across many battles (--events), stored by
+// column. Each thread fills its own block of rows without taking a lock;
+// full blocks go to a background writer that packs every column down to the
+// bits its values need and appends the block to the file. While logging is
+// off, recording a hit costs a single predicted branch.
+#define EVENT_BLOCK_ROWS 16384      // Rows per block
+#define EVENT_QUEUE_BLOCKS 8        // Full blocks waiting for the writer
+#define EVENT_MAX_THREADS 64        // Threads past this go unlogged
+#define EVENT_NO_ITEM NUMBER_OF_ITEMS
+
+typedef enum {
+    EV_ATTACKER_ITEM1,              // Catalog ids, EVENT_NO_ITEM for an empty hand
+    EV_ATTACKER_ITEM2,
+    EV_TARGET_ITEM1,
+    EV_TARGET_ITEM2,
+    EV_DAMAGE,
+    EV_DISTANCE,                    // Manhattan distance between the two
+    EV_KILL,                        // 1 when the target fell
+    EV_ROUND,
+    EVENT_COLUMNS
+} EventColumn;
+
+extern bool eventlog_on;
+
+void eventlog_append(const uint32_t row[EVENT_COLUMNS]);
+
+// Starts logging to `path`; the rest is written when the program exits
+bool eventlog_start(const char *path);
+
+// Writes what is still buffered and closes the file
+void eventlog_finish(void);
+
+static inline uint32_t event_item(const ITEM *item) {
+    int idx = item_index(item);
+    return idx < 0 ? EVENT_NO_ITEM : (uint32_t)idx;
+}
+
+// `kill` is set on the hit that took the target's hp to zero
+static inline void eventlog_hit(const UNIT *attacker, const UNIT *target, int damage,
+                                int distance, int round, bool kill) {
+    if (__builtin_expect(eventlog_on, 0)) {
+        uint32_t row[EVENT_COLUMNS] = {
+            event_item(attacker->item1), event_item(attacker->item2),
+            event_item(target->item1), event_item(target->item2),
+            (uint32_t)damage, (uint32_t)distance, kill, (uint32_t)round
+        };
+        eventlog_append(row);
+    }
+}
+
+// Scans an event file and prints per-item and per-matchup totals to stdout.
+// Returns 0 on success.
+int run_event_query(const char *path);
+
+#endif // EVENTLOG_H
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include "battlefield.h"
+
+// Maps an octant's (col, row) onto board offsets: dx = col * xx + row * xy,
+// dy = col * yx + row * yy. Together the eight octants cover every direction.
+static const int octants[8][4] = {
+    { 1,  0,  0,  1}, { 0,  1,  1,  0}, { 0, -1,  1,  0}, {-1,  0,  0,  1},
+    {-1,  0,  0, -1}, { 0, -1, -1,  0}, { 0,  1, -1,  0}, { 1,  0,  0, -1},
+};
+
+int unit_sight(const UNIT *unit) {
+    int sight = unit_range(unit) + 1;
+    if (sight < SIGHT_RADIUS) return SIGHT_RADIUS;
+    if (sight > MAX_SIGHT_RADIUS) return MAX_SIGHT_RADIUS;
+    return sight;
+}
+
+// Recursive shadowcasting over one octant, rows `row` to `radius` away,
+// between slopes `start` and `end`. Units and walls block sight but are
+// seen themselves; the edge of the board blocks like a wall.
+static void cast_light(Bitboard opaque, int ox, int oy, int radius, int row,
+                       double start, double end, const int m[4], Bitboard *seen) {
+    if (start < end) return;
+    double new_start = 0.0;
+    for (int j = row; j <= radius; j++) {
+        bool blocked = false;
+        for (int col = -j; col <= 0; col++) {
+            int dx = col * m[0] + -j * m[1], dy = col * m[2] + -j * m[3];
+            int x = ox + dx, y = oy + dy;
+            double left = (col - 0.5) / (-j + 0.5);
+            double right = (col + 0.5) / (-j - 0.5);
+            if (start < right) continue;
+            if (end > left) break;
+
+            bool inside = is_valid_position(x, y);
+            if (inside && abs(dx) + abs(dy) <= radius) *seen |= cell_bit(x, y);
+            bool wall = !inside || (opaque & cell_bit(x, y));
+            if (blocked) {
+                if (wall) {
+                    new_start = right;
+                    continue;
+                }
+                blocked = false;
+                start = new_start;
+            } else if (wall && j < radius) {
+                blocked = true;
+                cast_light(opaque, ox, oy, radius, j + 1, start, left, m, seen);
+                new_start = right;
+            }
+        }
+        if (blocked) break;
+    }
+}
+
+// Cells seen from (x, y) within Manhattan distance `radius`, the cell itself included
+Bitboard field_of_view(const Battlefield *bf, int x, int y, int radius) {
+    Bitboard opaque = (bf->occupied[0] | bf->occupied[1] | bf->opaque) & ~cell_bit(x, y);
+    Bitboard seen = cell_bit(x, y);
+    for (int o = 0; o < 8; o++) {
+        cast_light(opaque, x, y, radius, 1, 1.0, 0.0, octants[o], &seen);
+    }
+    return seen;
+}
+
+// Swaps the slot's references for its current field of view, touching only
+// the cells that changed. A free slot just drops its references.
+static void refresh_sight(Battlefield *bf, int idx) {
+    FogOfWar *fog = &bf->fog;
+    const UnitSlot *slot = &bf->slots[idx];
+    int t = slot->team - 1;     // Still set on a slot that was just freed
+
+    Bitboard now = slot->unit ? field_of_view(bf, slot->pos.x, slot->pos.y, unit_sight(slot->unit)) : 0;
+    Bitboard gone = fog->sight[idx] & ~now;
+    Bitboard added = now & ~fog->sight[idx];
+    while (gone) {
+        int cell = bb_pop(&gone);
+        if (--fog->refs[t][cell] == 0) fog->visible[t] &= ~((Bitboard)1 << cell);
+    }
+    while (added) {
+        int cell = bb_pop(&added);
+        if (fog->refs[t][cell]++ == 0) fog->visible[t] |= (Bitboard)1 << cell;
+    }
+    fog->sight[idx] = now;
+}
+
+// Whether one of the changed cells lies in the square the slot's unit scans
+static bool in_scan(const UnitSlot *slot, Bitboard changed) {
+    int radius = unit_sight(slot->unit);
+    while (changed) {
+        int cell = bb_pop(&changed);
+        if (abs(cell % MAX_GRID_WIDTH - slot->pos.x) <= radius &&
+            abs(cell / MAX_GRID_WIDTH - slot->pos.y) <= radius) return true;
+    }
+    return false;
+}
+
+// Recasts every unit's field of view from scratch
+void fog_enable(Battlefield *bf, bool enabled) {
+    FogOfWar *fog = &bf->fog;
+    memset(fog->refs, 0, sizeof(fog->refs));
+    memset(fog->sight, 0, sizeof(fog->sight));
+    fog->visible[0] = fog->visible[1] = 0;
+    fog->enabled = enabled;
+    if (!enabled) return;
+
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        if (bf->slots[s].unit) refresh_sight(bf, s);
+    }
+}
+
+// Called whenever the unit in `slot` was placed, moved or removed, with the
+// cells whose occupancy changed. That unit recasts its view, and so does
+// every unit for which one of those cells could block or open a line.
+void fog_update(Battlefield *bf, int slot, Bitboard changed) {
+    if (!bf->fog.enabled) return;
+
+    refresh_sight(bf, slot);
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        if (s == slot || !bf->slots[s].unit) continue;
+        if (in_scan(&bf->slots[s], changed)) refresh_sight(bf, s);
+    }
+}
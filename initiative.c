@@ -0,0 +1,96 @@
+#include <string.h>
+#include "battlefield.h"
+
+// Time between a unit's actions: everything it carries weighs it down, and
+// so does every slot it fills
+int unit_delay(const UNIT *unit) {
+    int delay = INITIATIVE_BASE;
+    const ITEM *held[2] = { unit->item1, unit->item2 };
+    for (int i = 0; i < 2; i++) {
+        if (held[i]) delay += held[i]->weight + held[i]->slots;
+    }
+    return delay;
+}
+
+void initiative_reset(Initiative *q) {
+    memset(q, 0, sizeof(*q));
+    memset(q->index, NOT_QUEUED, sizeof(q->index));
+}
+
+static bool acts_before(const Initiative *q, int a, int b) {
+    return q->ready[a] != q->ready[b] ? q->ready[a] < q->ready[b] : a < b;
+}
+
+static void put(Initiative *q, int at, int slot) {
+    q->heap[at] = (int8_t)slot;
+    q->index[slot] = (int8_t)at;
+}
+
+static void sift_up(Initiative *q, int at) {
+    int slot = q->heap[at];
+    while (at > 0) {
+        int parent = (at - 1) / 2;
+        if (!acts_before(q, slot, q->heap[parent])) break;
+        put(q, at, q->heap[parent]);
+        at = parent;
+    }
+    put(q, at, slot);
+}
+
+static void sift_down(Initiative *q, int at) {
+    int slot = q->heap[at];
+    for (;;) {
+        int child = 2 * at + 1;
+        if (child >= q->count) break;
+        if (child + 1 < q->count && acts_before(q, q->heap[child + 1], q->heap[child])) child++;
+        if (!acts_before(q, q->heap[child], slot)) break;
+        put(q, at, q->heap[child]);
+        at = child;
+    }
+    put(q, at, slot);
+}
+
+// Queues a unit that just came onto the board, to act one delay from now
+void initiative_add(Battlefield *bf, int slot) {
+    Initiative *q = &bf->initiative;
+    if (q->index[slot] != NOT_QUEUED) return;
+
+    q->ready[slot] = q->now + (uint32_t)unit_delay(bf->slots[slot].unit);
+    q->index[slot] = (int8_t)q->count;
+    q->heap[q->count++] = (int8_t)slot;
+    sift_up(q, q->count - 1);
+}
+
+void initiative_remove(Battlefield *bf, int slot) {
+    Initiative *q = &bf->initiative;
+    int at = q->index[slot];
+    if (at == NOT_QUEUED) return;
+
+    q->index[slot] = NOT_QUEUED;
+    int last = q->heap[--q->count];
+    if (at == q->count) return;
+    put(q, at, last);
+    sift_up(q, at);
+    sift_down(q, q->index[last]);
+}
+
+// Moves a queued unit to act at `ready`, for restoring a saved order or
+// after its delay changed
+void initiative_set(Battlefield *bf, int slot, uint32_t ready) {
+    Initiative *q = &bf->initiative;
+    int at = q->index[slot];
+    if (at == NOT_QUEUED) return;
+
+    bool earlier = ready < q->ready[slot];
+    q->ready[slot] = ready;
+    if (earlier) sift_up(q, at);
+    else sift_down(q, at);
+}
+
+// The unit has taken its turn: it goes again one delay later
+void initiative_act(Battlefield *bf, int slot) {
+    Initiative *q = &bf->initiative;
+    if (q->index[slot] == NOT_QUEUED) return;
+    q->now = q->ready[slot];
+    initiative_set(bf, slot, q->now + (uint32_t)unit_delay(bf->slots[slot].unit));
+}
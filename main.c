@@ -9,6 +9,20 @@
 #include <unistd.h>       // For system stuff like sleep
 #include "data.h"         // Our game items and units
 #include "battlefield.h"  // The game board and battle logic
+#include "server.h"       // Match server for hosting many games at once
+#include "client.h"       // Thin client that plays on a match server
+#include "render.h"       // Optional framebuffer renderer that bypasses ncurses
+#include "cast.h"         // Asciicast recordings of battles
+#include "simul.h"        // AI unit intents and simultaneous rounds
+#include "army.h"         // Army definitions and their error codes
+#include "tourney.h"      // Round-robin tournaments between many armies
+#include "art.h"          // Menu art built into the game
+#include "popup.h"        // Reusable popup windows for menus
+#include "undo.h"         // Undo and redo for the two-player game
+#include "state.h"        // Pointer-free copy of a battle, for save files
+#include "trace.h"        // Timeline of what the game spends its time on (--trace)
+#include "eventlog.h"     // Combat events for analysis across many battles (--events)
+#include <time.h>         // For timing the renderer benchmark
 
 // These files contain our cool ASCII art for the menu
 #define TITLE_FILE     "title.txt"
@@ -27,38 +41,84 @@ static const char *labels[]      = { "Start", "Exit" };
 static const char *mode_labels[] = { "AI Game", "Simple Game", "Load Game", "Back" };  // Game modes
 enum { BTN_START=0, BTN_EXIT, BTN_COUNT };           // Makes it easier to work with menu buttons
 enum { MODE_AI=0, MODE_SIMPLE, MODE_LOAD, MODE_BACK, MODE_COUNT };  // Different game modes
+static bool use_ansi_renderer = false;  // Draw battles with the framebuffer renderer (--ansi)
+static const char *record_path = NULL;   // Record AI battles to this asciicast file (--record)
+static bool simultaneous_rounds = false; // Both armies plan at once and act together (--simultaneous)
+static bool fog_of_war = false;         // Armies only see what their units see (--fog)
+static uint8_t battle_terrain[MAX_GRID_WIDTH * MAX_GRID_HEIGHT]; // Terrain for every battle, all plain without --map
+static const char *log_title = "";      // Title above the log window, redrawn after a resize
+#define RECORD_MAX_ROUNDS 1000               // Recordings can't wait for a human to quit a stalemate
+#define RESIZE_SETTLE_MS 30                  // Quiet time that ends a burst of resize events
 #define BTN_W 20    // How wide our buttons are
 #define BTN_H 5     // How tall our buttons are
 
-// Error codes for when something goes wrong
-#define ERR_UNIT_COUNT  (-1)    // Too many or too few units
-#define ERR_ITEM_COUNT  (-2)    // Problem with items
-#define ERR_WRONG_ITEM  (-3)    // Invalid item selected
-#define ERR_SLOTS       (-4)    // Not enough inventory slots
-
 // This helps us load and display ASCII art
 typedef struct {
-    int width, height;   // Size of the art
-    char **lines;        // The actual art content
+    int width, height;          // Size of the art (width in screen columns)
+    const char *const *lines;   // The actual art content
+    bool owned;                 // Read from a file, so free_art has to free it
 } AsciiArt;
 
 // These are function declarations - we'll define them later
-static Position find_closest_enemy(const Battlefield *bf, int team, int x, int y);
-static bool move_towards_target(Battlefield *bf, Position *unit_pos, Position target);
-
 static int update_field(UNIT *field[], int count);
 static void draw_field1D(WINDOW *win,
                          UNIT *pole1[], int n1,
                          UNIT *pole2[], int n2);
-static int item_index(const ITEM *it);
 static bool save_game(const char *filename,
                       UNIT a1[], int n1,
                       UNIT a2[], int n2,
-                      int turn);
+                      const BattleState *st);
 static bool load_game(const char *filename,
                       UNIT a1[], int *n1,
                       UNIT a2[], int *n2,
-                      int *turn);
+                      int *turn,
+                      BattleState *st,
+                      bool *has_state);
+
+// Stretches the log window back over the whole screen after the terminal
+// changes size. It always sits at (2,1), so only its size changes.
+static void fit_log_window(WINDOW *logwin) {
+    werase(stdscr);
+    box(stdscr, 0, 0);
+    mvprintw(1, (COLS - (int)strlen(log_title)) / 2, "%s", log_title);
+    wnoutrefresh(stdscr);
+    wresize(logwin, LINES - 4, COLS - 2);
+}
+
+// Dragging a terminal edge sends a stream of KEY_RESIZE. We wait until the
+// stream pauses and then move the existing windows into place once,
+// instead of redrawing the whole battle for every event.
+static void handle_resize(Battlefield *bf, WINDOW *win, const UNIT *selected_unit) {
+    int ch;
+    wtimeout(win, RESIZE_SETTLE_MS);
+    while ((ch = wgetch(win)) == KEY_RESIZE) {
+        // Still dragging
+    }
+    wtimeout(win, -1);
+    if (ch != ERR) ungetch(ch);  // A real key press, keep it for the game
+    
+    fit_log_window(win);
+    if (!check_window_size(LINES, COLS)) {
+        // Leave the panels alone until there's room for them again
+        werase(win);
+        mvwprintw(win, 1, 2, "Terminal too small, make it at least %dx%d",
+                  MIN_WINDOW_WIDTH, MIN_WINDOW_HEIGHT);
+        wrefresh(win);
+        return;
+    }
+    resize_windows(bf, win);
+    if (bf->ansi) ansi_resize(bf, LINES, COLS);
+    update_all_displays(win, bf, selected_unit);
+}
+
+// Blocking key read that follows the terminal through resizes
+static int read_key(Battlefield *bf, WINDOW *win, const UNIT *selected_unit) {
+    int ch;
+    while ((ch = wgetch(win)) == KEY_RESIZE) {
+        handle_resize(bf, win, selected_unit);
+    }
+    return ch;
+}
 
 // This function keeps track of which units are still alive
 static int update_field(UNIT *field[], int count) {
@@ -70,14 +130,6 @@ static int update_field(UNIT *field[], int count) {
     return alive;  // Return how many units are still fighting
 }
 
-// Finds which item number an item is in our database
-static int item_index(const ITEM *it) {
-    if(!it) return -1;  // If there's no item, return -1
-    for(int i = 0; i < NUMBER_OF_ITEMS; i++)
-        if(&items[i] == it) return i;  // Found it!
-    return -1;  // Item not found in our database
-}
-
 // This is what we save for each unit when saving the game
 typedef struct {
     char name[MAX_NAME+1];  // Unit's name
@@ -90,8 +142,11 @@ typedef struct {
 static bool save_game(const char *filename,
                       UNIT a1[], int n1,  // Army 1's units and count
                       UNIT a2[], int n2,  // Army 2's units and count
-                      int turn)           // Whose turn it is
+                      const BattleState *st) // Where everyone stands and whose turn it is
 {
+    TRACE_SCOPE("save_game");
+    int turn = st->turn;
+
     // Try to open the save file
     FILE *f = fopen(filename, "wb");
     if(!f) return false;  // Couldn't open file :(
@@ -122,6 +177,9 @@ static bool save_game(const char *filename,
         fwrite(&su, sizeof su, 1, f);
     }
     
+    // The board goes last, so older versions can still read the armies
+    fwrite(st, sizeof(*st), 1, f);
+    
     fclose(f);  // Close the file
     return true;  // Everything saved successfully!
 }
@@ -130,8 +188,11 @@ static bool save_game(const char *filename,
 static bool load_game(const char *filename,
                       UNIT a1[], int *n1,  // Where to put army 1's units
                       UNIT a2[], int *n2,  // Where to put army 2's units
-                      int *turn)           // Where to store whose turn it is
+                      int *turn,           // Where to store whose turn it is
+                      BattleState *st,     // Where to put the board, if the file has one
+                      bool *has_state)     // Set when it did
 {
+    TRACE_SCOPE("load_game");
     // Try to open the save file
     FILE *f = fopen(filename, "rb");
     if(!f) return false;  // File doesn't exist or can't be opened
@@ -164,14 +225,33 @@ static bool load_game(const char *filename,
         a2[i].item2 = (su.idx2 >= 0 && su.idx2 < NUMBER_OF_ITEMS) ? &items[su.idx2] : NULL;
     }
     
+    // Saves from before unit positions were kept end here
+    *has_state = fread(st, sizeof(*st), 1, f) == 1 && state_valid(st);
+    for (int u = 0; *has_state && u < UNIT_SLOTS; u++) {
+        int count = u < MAX_ARMY ? *n1 : *n2;
+        if (st->units[u].team != 0 && u % MAX_ARMY >= count) *has_state = false;
+    }
+    if (*has_state) *turn = st->turn;
+    
     fclose(f);  // Close the file
     return true;  // Everything loaded successfully!
 }
 
+// Tells the players what the burns did at the end of a turn
+static void show_effect_report(Battlefield *bf, const EffectReport *report) {
+    if (report->defeated[0] + report->defeated[1] > 0) {
+        display_combat_message(bf, "Burns deal %d damage, lost: %d / %d", report->damage,
+                               report->defeated[0], report->defeated[1]);
+    } else {
+        display_combat_message(bf, "Burns deal %d damage", report->damage);
+    }
+    battle_pause(bf, 500000);
+}
+
 // This is our main game function where two players battle it out!
 int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                       UNIT a2[], int *n2,       // Army 2's units and count
-                      int init_turn,            // Who goes first
+                      const BattleState *resume, // Board from a save file, or NULL for a new game
                       WINDOW *win)              // The window to draw in
 {
     // Get the size of our game window
@@ -185,25 +265,46 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
     
     // Create our game board and get it ready
     Battlefield bf;
+    CombatLog log = {0};               // What the message line said, for L to scroll back through
     init_battlefield(&bf);
     bf.main_win = win;  // Remember which window we're using
+    bf.log = &log;
     create_status_windows(&bf, wy, wx);  // Make windows for game info
+    if (use_ansi_renderer) enable_ansi_renderer(&bf, LINES, COLS, NULL, NULL);
+    set_terrain(&bf, battle_terrain);    // Walls, water and forest from --map
     
-    // Put army 1's units on the left side of the board
-    for (int i = 0; i < *n1; i++) {
-        place_unit(&bf, &a1[i], 1, 0, i * 2);  // Space them out every other square
-    }
+    int sizes[2] = {*n1, *n2};         // Whole armies, so saves keep the fallen too
+    UNIT *const armies[2] = {a1, a2};
     
-    // Put army 2's units on the right side of the board
-    for (int i = 0; i < *n2; i++) {
-        place_unit(&bf, &a2[i], 2, GRID_WIDTH - 1, i * 2);
+    if (resume) {
+        // Everyone goes back where they stood when the game was saved
+        int alive[2];
+        state_restore(&bf, resume, armies, alive);
+        *n1 = alive[0];
+        *n2 = alive[1];
+    } else {
+        // Put army 1's units on the left side of the board
+        for (int i = 0; i < *n1; i++) {
+            place_unit(&bf, &a1[i], 1, 0, i * 2);  // Space them out every other square
+        }
+        
+        // Put army 2's units on the right side of the board
+        for (int i = 0; i < *n2; i++) {
+            place_unit(&bf, &a2[i], 2, GRID_WIDTH - 1, i * 2);
+        }
     }
     
     // Set up our game state
-    int turn = init_turn;              // Whose turn is it
+    int actor = initiative_next(&bf);  // Slot of the unit whose turn it is, -1 on an empty board
+    int turn = actor >= 0 ? bf.slots[actor].team : 1;  // Whose turn is it: the player that unit belongs to
+    bool new_turn = true;              // Point the cursor at the unit to act
+    fog_enable(&bf, fog_of_war);       // With fog, each player only sees what their units see
+    bf.fog.viewer = turn;
     UNIT *selected_unit = NULL;        // Which unit is selected
     bool has_moved = false;            // Has the current unit moved
     bool has_attacked = false;         // Has the current unit attacked
+    UndoHistory history;               // Lets players take actions back with U and R
+    undo_init(&history, &bf);
     
     // Show the initial game board
     set_game_state(&bf, STATE_SELECT_UNIT);
@@ -211,15 +312,34 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
     
     // Main game loop - keep going until one army is defeated
     while (*n1 > 0 && *n2 > 0) {
+        // Hand the board over to the player whose turn it is
+        if (bf.fog.enabled && bf.fog.viewer != turn) {
+            bf.fog.viewer = turn;
+            update_all_displays(win, &bf, selected_unit);
+        }
+        
+        // Units act in initiative order; the cursor starts on the one up next
+        actor = initiative_next(&bf);
+        if (actor < 0) break;   // Nobody left to act
+        bf.round = (int)(bf.initiative.ready[actor] / ROUND_TIME) + 1;
+        if (new_turn) {
+            bf.cursor_pos = bf.slots[actor].pos;
+            update_all_displays(win, &bf, selected_unit);
+            new_turn = false;
+        }
+        
         // Show whose turn it is
-        display_combat_message(&bf, "Player %d's turn", turn);
+        display_combat_message(&bf, "Player %d's turn: %s", turn, bf.slots[actor].unit->name);
         
         // Get player input
         int ch = wgetch(win);
+        TRACE_SCOPE("input");   // Everything the key sets off, until the next one
         
         // Handle save game request
         if (ch == 's' || ch == 'S') {
-            if (save_game(SAVE_FILE, a1, *n1, a2, *n2, turn)) {
+            BattleState snapshot;
+            state_capture(&snapshot, &bf, (const UNIT *const[]){armies[0], armies[1]}, sizes, turn);
+            if (save_game(SAVE_FILE, a1, sizes[0], a2, sizes[1], &snapshot)) {
                 display_combat_message(&bf, "Game saved to %s", SAVE_FILE);
             } else {
                 display_combat_message(&bf, "Save failed!");
@@ -232,9 +352,34 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
             break;
         }
         
+        // Take back the last action, or bring back one that was taken back
+        if ((ch == 'u' || ch == 'U' || ch == 'r' || ch == 'R') && bf.state == STATE_SELECT_UNIT) {
+            bool undo = (ch == 'u' || ch == 'U');
+            if (undo ? undo_step(&history, &bf, &turn) : redo_step(&history, &bf, &turn)) {
+                *n1 = bf.unit_counts[0];  // Undoing a kill brings the unit back
+                *n2 = bf.unit_counts[1];
+                new_turn = true;
+                update_all_displays(win, &bf, selected_unit);
+                display_combat_message(&bf, undo ? "Action undone. Player %d's turn" : "Action redone. Player %d's turn", turn);
+            } else {
+                display_combat_message(&bf, undo ? "Nothing to undo" : "Nothing to redo");
+            }
+            battle_pause(&bf, 300000);
+            continue;
+        }
+        
+        // Handle the terminal changing size
+        if (ch == KEY_RESIZE) {
+            handle_resize(&bf, win, selected_unit);
+            getmaxyx(win, wy, wx);
+            continue;
+        }
+        
         // Keep track if we need to update the display
         bool update_needed = false;
         bool action_taken = false;
+        bool turn_over = false;            // Every action ends the unit's turn
+        int turn_before = turn;
         
         // Handle different key presses
         switch (ch) {
@@ -262,13 +407,42 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                     update_needed = true;
                 }
                 break;
+            case KEY_PPAGE:  // Scroll the unit list up
+            case KEY_NPAGE:  // ...or down, a panel at a time
+                {
+                    int page = bf.layout.unit_list.height - 2;
+                    unit_list_scroll(&bf, ch == KEY_PPAGE ? -page : page, page);
+                    update_needed = true;
+                }
+                break;
+            case 'o':        // Change how the unit list is sorted
+            case 'O':
+                unit_list_cycle_sort(&bf);
+                display_combat_message(&bf, "Unit list sorted by %s",
+                                       unit_list_sort_name(bf.unit_list.sort));
+                update_needed = true;
+                break;
+            case 'l':        // Scroll back through the combat log
+            case 'L':
+                browse_combat_log(&bf);
+                update_needed = true;
+                break;
             case 10: // Enter
                 switch (bf.state) {
                     case STATE_SELECT_UNIT:
                         {
-                            GridCell *cell = &bf.cells[bf.cursor_pos.y][bf.cursor_pos.x];
-                            if (cell->unit && cell->team == turn) {
-                                selected_unit = cell->unit;
+                            const UnitSlot *slot = slot_at(&bf, bf.cursor_pos.x, bf.cursor_pos.y);
+                            if (slot && slot != &bf.slots[actor] && slot->team == turn) {
+                                display_combat_message(&bf, "It's %s's turn", bf.slots[actor].unit->name);
+                                battle_pause(&bf, 500000);
+                            } else if (slot == &bf.slots[actor] && has_effect(&bf, actor, EFFECT_FREEZE)) {
+                                // A frozen unit can't act, so picking it passes its turn
+                                display_combat_message(&bf, "%s is frozen and can't act", slot->unit->name);
+                                battle_pause(&bf, 500000);
+                                action_taken = true;
+                                turn_over = true;
+                            } else if (slot == &bf.slots[actor]) {
+                                selected_unit = slot->unit;
                                 bf.has_selection = true;
                                 bf.selected_pos = bf.cursor_pos;
                                 set_game_state(&bf, STATE_SELECT_ACTION);
@@ -282,6 +456,7 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                                 
                                 ActionType action = show_action_menu(&menu, selected_unit);
                                 destroy_action_menu(&menu);
+                                invalidate_display(&bf);
                                 
                                 switch (action) {
                                     case ACTION_MOVE:
@@ -296,8 +471,28 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                                             display_combat_message(&bf, "Choose target for %s", selected_unit->name);
                                         }
                                         break;
+                                    case ACTION_SPECIAL:
+                                        if (!has_attacked) {
+                                            // The blast is centered on the caster, no target to pick
+                                            use_special_ability(&bf, selected_unit, bf.selected_pos.x,
+                                                                bf.selected_pos.y, turn == 1 ? n2 : n1);
+                                            action_taken = true;
+                                            
+                                            turn_over = true;
+                                            has_moved = false;
+                                            has_attacked = false;
+                                            bf.has_selection = false;
+                                            selected_unit = NULL;
+                                            set_game_state(&bf, STATE_SELECT_UNIT);
+                                        }
+                                        break;
                                     case ACTION_END_TURN:
-                                        turn = 3 - turn;
+                                        // Ending the turn without acting raises a shield
+                                        if (brace_unit(&bf, actor)) {
+                                            display_combat_message(&bf, "%s raises a shield", selected_unit->name);
+                                            battle_pause(&bf, 500000);
+                                        }
+                                        turn_over = true;
                                         has_moved = false;
                                         has_attacked = false;
                                         bf.has_selection = false;
@@ -322,7 +517,7 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                             has_moved = true;
                             action_taken = true;
                             
-                            turn = 3 - turn;
+                            turn_over = true;
                             has_moved = false;
                             has_attacked = false;
                             bf.has_selection = false;
@@ -339,12 +534,12 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
                                                  bf.selected_pos.x, bf.selected_pos.y,
                                                  bf.cursor_pos.x, bf.cursor_pos.y)) {
                             Position target_pos = bf.cursor_pos;
-                            int *remaining = (bf.cells[target_pos.y][target_pos.x].team == 1) ? n1 : n2;
+                            int *remaining = (team_at(&bf, target_pos.x, target_pos.y) == 1) ? n1 : n2;
                             perform_combat(&bf, &bf.selected_pos, &target_pos, remaining);
                             has_attacked = true;
                             action_taken = true;
                             
-                            turn = 3 - turn;
+                            turn_over = true;
                             has_moved = false;
                             has_attacked = false;
                             bf.has_selection = false;
@@ -375,9 +570,26 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
             update_all_displays(win, &bf, selected_unit);
         }
         
+        // The unit goes back in line, effects move on for the time that passes
+        // until the next unit's turn, and then the whole turn can be undone
+        if (turn_over) {
+            int remaining[2] = {*n1, *n2};
+            EffectReport report;
+            end_turn(&bf, actor, remaining, &report);
+            *n1 = remaining[0];
+            *n2 = remaining[1];
+            if (initiative_next(&bf) >= 0) turn = bf.slots[initiative_next(&bf)].team;
+            new_turn = true;
+            if (report.burns > 0) {
+                update_all_displays(win, &bf, selected_unit);
+                show_effect_report(&bf, &report);
+            }
+            undo_record(&history, &bf, turn_before, turn);
+        }
+        
         if (action_taken) {
             display_combat_message(&bf, "Turn ended. Player %d's turn", turn);
-            usleep(500000);
+            battle_pause(&bf, 500000);
         }
     }
     
@@ -395,21 +607,14 @@ int simple_game_curses(UNIT a1[], int *n1,       // Army 1's units and count
     }
     
     display_controls_hint(&bf, "Press any key to continue...");
-    wgetch(win);
+    read_key(&bf, win, NULL);
     
     // Cleanup
+    disable_ansi_renderer(&bf);
     destroy_status_windows(&bf);
     return 0;
 }
 
-static const ITEM* find_item(const char *name) {
-    for (int i = 0; i < NUMBER_OF_ITEMS; i++) {
-        if (strcmp(items[i].name, name) == 0)
-            return &items[i];
-    }
-    return NULL;
-}
-
 static void fix_blanks(char *s) {
     char *p = s;
     while (*p) {
@@ -424,27 +629,51 @@ static void fix_blanks(char *s) {
     }
 }
 
+// Screen columns of a UTF-8 string: every byte that doesn't continue a character
+static int art_columns(const char *s) {
+    int n = 0;
+    for (; *s; s++)
+        if (((unsigned char)*s & 0xC0) != 0x80) n++;
+    return n;
+}
+
+// Art files next to the game win, so art can be changed without rebuilding.
+// Otherwise we use the copy built into the game, which costs no I/O at all.
 static AsciiArt load_art(const char *fname) {
-    AsciiArt A = {0,0,NULL};
+    AsciiArt A = {0,0,NULL,false};
     FILE *f = fopen(fname,"r");
-    if (!f) return A;
+    if (!f) {
+        for (int i = 0; i < art_asset_count; i++) {
+            if (strcmp(art_assets[i].file, fname) == 0) {
+                A.width = art_assets[i].width;
+                A.height = art_assets[i].height;
+                A.lines = art_assets[i].lines;
+            }
+        }
+        return A;
+    }
     char buf[512];
+    char **lines = NULL;
     while (fgets(buf,sizeof(buf),f)) {
         int len = strlen(buf);
         if (len && buf[len-1]=='\n') buf[--len]=0;
+        if (len && buf[len-1]=='\r') buf[--len]=0;
         fix_blanks(buf);
-        A.lines = realloc(A.lines, sizeof(char*)*(A.height+1));
-        A.lines[A.height] = strdup(buf);
-        if (len > A.width) A.width = len;
+        lines = realloc(lines, sizeof(char*)*(A.height+1));
+        lines[A.height] = strdup(buf);
+        if (art_columns(buf) > A.width) A.width = art_columns(buf);
         A.height++;
     }
     fclose(f);
+    A.lines = (const char *const *)lines;
+    A.owned = true;
     return A;
 }
 
 static void free_art(AsciiArt *A) {
-    for (int i = 0; i < A->height; i++) free(A->lines[i]);
-    free(A->lines);
+    if (!A->owned) return;
+    for (int i = 0; i < A->height; i++) free((char *)A->lines[i]);
+    free((char **)A->lines);
 }
 
 static void draw_background(int maxh, int maxw,
@@ -568,44 +797,96 @@ static void draw_field1D(WINDOW *win,
 
 #include <unistd.h>
 #define MAX(a,b) ((a)>(b)?(a):(b))
-int simulate_battle_curses(UNIT a1[], int n1, UNIT a2[], int n2, int max_rounds, WINDOW *win) {
-    int wy, wx;
-    getmaxyx(win, wy, wx);
+
+// Carries out an AI unit's intent straight away, with the usual animations
+static bool act_on_intent(Battlefield *bf, const Intent *intent, int *enemies_left) {
+    Position from = intent->from, to = intent->to;
     
-    scrollok(win, FALSE);
-    curs_set(0);
+    // Point the cursor, and with it the view, at the unit that acts
+    if (intent->type != INTENT_WAIT) bf->cursor_pos = intent->type == INTENT_MOVE ? to : from;
     
-    // Initialize battlefield
+    switch (intent->type) {
+        case INTENT_SPECIAL:
+            return use_special_ability(bf, unit_at(bf, from.x, from.y), from.x, from.y, enemies_left);
+        case INTENT_ATTACK:
+            return perform_combat(bf, &from, &to, enemies_left);
+        case INTENT_MOVE:
+            return move_unit(bf, from.x, from.y, to.x, to.y);
+        default:
+            // Waiting raises a shield, if the unit carries one and isn't frozen
+            brace_unit(bf, HANDLE_SLOT(intent->actor));
+            return false;
+    }
+}
+
+// Runs an AI battle. With a recorder the battle is drawn straight into the
+// asciicast file at full speed: no window, no input and no real sleeping.
+int simulate_battle_curses(UNIT a1[], int n1, UNIT a2[], int n2, int max_rounds,
+                           WINDOW *win, CastRecorder *recorder) {
+    int wy, wx;
     Battlefield bf;
+    CombatLog log = {0};
     init_battlefield(&bf);
-    bf.main_win = win;  // Store main window for combat updates
-    create_status_windows(&bf, wy, wx);
+    bf.log = &log;
+    
+    if (recorder) {
+        // Lay the recording out like the interactive screen: main window at (2,1)
+        wy = CAST_ROWS - 4;
+        wx = CAST_COLS - 2;
+        calculate_grid_dimensions(&bf, wy, wx);
+        calculate_panel_layout(&bf.layout, wy, wx);
+        bf.recorder = recorder;
+        enable_ansi_renderer(&bf, CAST_ROWS, CAST_COLS, cast_sink, recorder);
+        bf.ansi->origin_y = MAIN_WIN_Y;
+        bf.ansi->origin_x = MAIN_WIN_X;
+    } else {
+        getmaxyx(win, wy, wx);
+        scrollok(win, FALSE);
+        curs_set(0);
+        bf.main_win = win;  // Store main window for combat updates
+        create_status_windows(&bf, wy, wx);
+        if (use_ansi_renderer) enable_ansi_renderer(&bf, LINES, COLS, NULL, NULL);
+    }
     
     // Place armies
+    set_terrain(&bf, battle_terrain);
     for (int i = 0; i < n1; i++) {
         place_unit(&bf, &a1[i], 1, 0, i * 2);
     }
     for (int i = 0; i < n2; i++) {
         place_unit(&bf, &a2[i], 2, MAX_GRID_WIDTH - 1, i * 2);
     }
+    fog_enable(&bf, fog_of_war);   // Spectators see both armies, shaded where neither looks
     
     update_all_displays(win, &bf, NULL);
-    display_combat_message(&bf, "Battle starting...");
+    if (simultaneous_rounds) {
+        display_combat_message(&bf, "Battle starting: simultaneous rounds");
+    } else {
+        display_combat_message(&bf, "Battle starting...");
+    }
     display_controls_hint(&bf, "Q: Quit simulation | Space: Pause/Resume | Any key: Step");
-    usleep(1000000);
+    battle_pause(&bf, 1000000);
     
     int round = 1;
     bool paused = false;
     bool step_mode = false;
     
     while (n1 > 0 && n2 > 0 && max_rounds != 0) {
+        bf.round = round;
         display_combat_message(&bf, "Round %d", round++);
         update_all_displays(win, &bf, NULL);
-        usleep(500000);
+        battle_pause(&bf, 500000);
         
-        // Handle user input
-        nodelay(win, TRUE);
-        int ch = wgetch(win);
+        // Handle user input (recordings run unattended)
+        int ch = ERR;
+        if (!recorder) {
+            nodelay(win, TRUE);
+            ch = wgetch(win);
+            if (ch == KEY_RESIZE) {
+                handle_resize(&bf, win, NULL);
+                ch = ERR;
+            }
+        }
         if (ch == 'q' || ch == 'Q') break;
         if (ch == ' ') {
             paused = !paused;
@@ -614,9 +895,14 @@ int simulate_battle_curses(UNIT a1[], int n1, UNIT a2[], int n2, int max_rounds,
         if (ch != ERR) step_mode = true;
         
         if (paused) {
-            display_combat_message(&bf, "Battle paused. Space: Resume, Q: Quit, Any key: Step");
+            display_combat_message(&bf, "Battle paused. Space: Resume, Q: Quit, L: Log, Any key: Step");
             nodelay(win, FALSE);
-            ch = wgetch(win);
+            ch = read_key(&bf, win, NULL);
+            while (ch == 'l' || ch == 'L') {
+                browse_combat_log(&bf);
+                update_all_displays(win, &bf, NULL);
+                ch = read_key(&bf, win, NULL);
+            }
             if (ch == 'q' || ch == 'Q') break;
             if (ch == ' ') {
                 paused = false;
@@ -626,90 +912,70 @@ int simulate_battle_curses(UNIT a1[], int n1, UNIT a2[], int n2, int max_rounds,
             }
         }
         
-        // Army 1 actions
-        if (n1 > 0 && n2 > 0) {
-            for (int i = 0; i < bf.unit_counts[0]; i++) {
-                Position *att_pos = &bf.positions[0][i];
-                UNIT *attacker = bf.cells[att_pos->y][att_pos->x].unit;
-                
-                // Try to attack first
-                bool acted = false;
-                Position *target_pos = NULL;
-                int min_dist = MAX_GRID_WIDTH + MAX_GRID_HEIGHT;
-                
-                for (int j = 0; j < bf.unit_counts[1]; j++) {
-                    Position *pos = &bf.positions[1][j];
-                    if (is_valid_attack_target(&bf, attacker, att_pos->x, att_pos->y, pos->x, pos->y)) {
-                        int dist = manhattan_distance(att_pos->x, att_pos->y, pos->x, pos->y);
-                        if (dist < min_dist) {
-                            min_dist = dist;
-                            target_pos = pos;
-                        }
-                    }
-                }
-                
-                if (target_pos) {
-                    perform_combat(&bf, att_pos, target_pos, &n2);
-                    acted = true;
-                } else {
-                    // If can't attack, try to move towards closest enemy
-                    Position closest = find_closest_enemy(&bf, 1, att_pos->x, att_pos->y);
-                    if (closest.x != -1) {
-                        acted = move_towards_target(&bf, att_pos, closest);
-                    }
-                }
-                
-                if (acted && step_mode) {
-                    nodelay(win, FALSE);
-                    display_combat_message(&bf, "Press any key to continue...");
-                    wgetch(win);
+        if (simultaneous_rounds) {
+            // Everyone decides from the same board, then the round resolves at once
+            Intent intents[UNIT_SLOTS];
+            RoundSummary summary;
+            int remaining[2] = {n1, n2};
+            plan_round(&bf, intents);
+            
+            // Keep the first fight of the round in view
+            for (int s = 0; s < UNIT_SLOTS; s++) {
+                if (intents[s].type == INTENT_ATTACK || intents[s].type == INTENT_SPECIAL) {
+                    bf.cursor_pos = intents[s].from;
+                    break;
                 }
-                
-                update_all_displays(win, &bf, NULL);
-                usleep(200000);
             }
+            resolve_round(&bf, intents, round % 2 + 1, remaining, &summary);
+            EffectReport report;
+            for (int t = 0; t < TICKS_PER_ROUND; t++) {
+                end_phase(&bf, remaining, &report);
+                summary.damage += report.damage;
+                summary.defeated[0] += report.defeated[0];
+                summary.defeated[1] += report.defeated[1];
+            }
+            n1 = remaining[0];
+            n2 = remaining[1];
+            
+            display_combat_message(&bf, "%d attacks for %d damage, %d moves (%d blocked), lost: %d / %d",
+                                   summary.attacks, summary.damage, summary.moves, summary.blocked,
+                                   summary.defeated[0], summary.defeated[1]);
+            update_all_displays(win, &bf, NULL);
+            if (step_mode) {
+                nodelay(win, FALSE);
+                read_key(&bf, win, NULL);
+            }
+            battle_pause(&bf, 500000);
         }
         
-        // Army 2 actions (similar logic)
-        if (n2 > 0 && n1 > 0) {
-            for (int i = 0; i < bf.unit_counts[1]; i++) {
-                Position *att_pos = &bf.positions[1][i];
-                UNIT *attacker = bf.cells[att_pos->y][att_pos->x].unit;
-                
-                bool acted = false;
-                Position *target_pos = NULL;
-                int min_dist = MAX_GRID_WIDTH + MAX_GRID_HEIGHT;
-                
-                for (int j = 0; j < bf.unit_counts[0]; j++) {
-                    Position *pos = &bf.positions[0][j];
-                    if (is_valid_attack_target(&bf, attacker, att_pos->x, att_pos->y, pos->x, pos->y)) {
-                        int dist = manhattan_distance(att_pos->x, att_pos->y, pos->x, pos->y);
-                        if (dist < min_dist) {
-                            min_dist = dist;
-                            target_pos = pos;
-                        }
-                    }
-                }
-                
-                if (target_pos) {
-                    perform_combat(&bf, att_pos, target_pos, &n1);
-                    acted = true;
-                } else {
-                    // If can't attack, try to move towards closest enemy
-                    Position closest = find_closest_enemy(&bf, 2, att_pos->x, att_pos->y);
-                    if (closest.x != -1) {
-                        acted = move_towards_target(&bf, att_pos, closest);
-                    }
-                }
-                
-                if (acted && step_mode) {
-                    nodelay(win, FALSE);
-                    display_combat_message(&bf, "Press any key to continue...");
-                    wgetch(win);
-                }
-                
+        // Otherwise units act one at a time in initiative order, each seeing the
+        // last one's result, until the round's time is up
+        uint32_t round_end = (uint32_t)(round - 1) * ROUND_TIME;
+        int slot;
+        while (!simultaneous_rounds && n1 > 0 && n2 > 0 &&
+               (slot = initiative_next(&bf)) >= 0 && bf.initiative.ready[slot] < round_end) {
+            int *enemies_left = (bf.slots[slot].team == 1) ? &n2 : &n1;
+            Intent intent;
+            choose_intent(&bf, slot_handle(&bf, slot), &intent);
+            bool acted = act_on_intent(&bf, &intent, enemies_left);
+            
+            if (acted && step_mode) {
+                nodelay(win, FALSE);
+                display_combat_message(&bf, "Press any key to continue...");
+                read_key(&bf, win, NULL);
+            }
+            
+            update_all_displays(win, &bf, NULL);
+            battle_pause(&bf, 200000);
+            
+            int remaining[2] = {n1, n2};
+            EffectReport report;
+            end_turn(&bf, slot, remaining, &report);
+            n1 = remaining[0];
+            n2 = remaining[1];
+            if (report.burns > 0) {
                 update_all_displays(win, &bf, NULL);
-                usleep(200000);
+                show_effect_report(&bf, &report);
             }
         }
         
@@ -717,28 +983,47 @@ int simulate_battle_curses(UNIT a1[], int n1, UNIT a2[], int n2, int max_rounds,
     }
     
     // Display final result with visual emphasis
+    if (!recorder) getmaxyx(win, wy, wx);
     if (n1 > 0 && n2 <= 0) {
-        wattron(win, COLOR_PAIR(1) | A_BOLD);
-        mvwprintw(win, wy/2, (wx-12)/2, "ARMY 1 WINS!");
-        wattroff(win, COLOR_PAIR(1) | A_BOLD);
+        if (bf.ansi) {
+            ansi_show_banner(&bf, 1, "ARMY 1 WINS!");
+        } else {
+            wattron(win, COLOR_PAIR(1) | A_BOLD);
+            mvwprintw(win, wy/2, (wx-12)/2, "ARMY 1 WINS!");
+            wattroff(win, COLOR_PAIR(1) | A_BOLD);
+        }
         display_combat_message(&bf, "Army 1 is victorious!");
     }
     else if (n2 > 0 && n1 <= 0) {
-        wattron(win, COLOR_PAIR(2) | A_BOLD);
-        mvwprintw(win, wy/2, (wx-12)/2, "ARMY 2 WINS!");
-        wattroff(win, COLOR_PAIR(2) | A_BOLD);
+        if (bf.ansi) {
+            ansi_show_banner(&bf, 2, "ARMY 2 WINS!");
+        } else {
+            wattron(win, COLOR_PAIR(2) | A_BOLD);
+            mvwprintw(win, wy/2, (wx-12)/2, "ARMY 2 WINS!");
+            wattroff(win, COLOR_PAIR(2) | A_BOLD);
+        }
         display_combat_message(&bf, "Army 2 is victorious!");
     }
     else {
-        mvwprintw(win, wy/2, (wx-8)/2, "DRAW!");
+        if (bf.ansi) ansi_show_banner(&bf, 0, "DRAW!");
+        else mvwprintw(win, wy/2, (wx-8)/2, "DRAW!");
         display_combat_message(&bf, "Battle ended in a draw!");
     }
     
+    if (recorder) {
+        // Hold the final frame for a moment so the player sees the result
+        battle_pause(&bf, 2000000);
+        display_controls_hint(&bf, "End of recording");
+        disable_ansi_renderer(&bf);
+        return 0;
+    }
+    
     wrefresh(win);
     display_controls_hint(&bf, "Press any key to continue...");
     nodelay(win, FALSE);
-    wgetch(win);
+    read_key(&bf, win, NULL);
     
+    disable_ansi_renderer(&bf);
     destroy_status_windows(&bf);
     return 0;
 }
@@ -819,8 +1104,282 @@ static int read_army_curses(WINDOW *win, int *y, UNIT army[], int *out_count) {
     return 0;
 }
 
+// Clears the screen and opens the framed window games print their setup into
+static WINDOW *open_log_window(int maxh, int maxw, const char *title) {
+    clear();
+    WINDOW *logwin = newwin(maxh - 4, maxw - 2, MAIN_WIN_Y, MAIN_WIN_X);
+    log_title = title;
+    box(stdscr, 0, 0);
+    mvprintw(1, (maxw - (int)strlen(title)) / 2, "%s", title);
+    wrefresh(stdscr);
+    scrollok(logwin, TRUE);
+    werase(logwin);
+    popup_attach(logwin);   // Item and action menus pop up over it
+    return logwin;
+}
+
+static void close_log_window(WINDOW *logwin) {
+    popup_detach(logwin);
+    delwin(logwin);
+}
+
+// Plays on a match server instead of running the game in this process
+static void play_online(const char *socket_path, int match_id, int team, int maxh, int maxw) {
+    WINDOW *logwin = open_log_window(maxh, maxw, " Online Game ");
+    int y = 1, err = 0;
+    UNIT army1[5], army2[5]; int c1 = 0, c2 = 0;
+
+    // Joining an existing match needs no setup; creating one needs both armies
+    if (match_id == 0 &&
+        ((err = read_army_curses(logwin, &y, army1, &c1)) < 0 ||
+         (err = read_army_curses(logwin, &y, army2, &c2)) < 0))
+    {
+        mvwprintw(logwin, y+1, 2, "Setup failed (%d). Press any key…", err);
+        wrefresh(logwin);
+        wgetch(logwin);
+    } else {
+        werase(logwin);
+        run_match_client(socket_path, match_id, team, army1, c1, army2, c2, logwin);
+    }
+    close_log_window(logwin);
+}
+
+// Counts what the framebuffer renderer writes while passing it through to stdout
+static void counting_sink(void *ctx, const char *data, size_t len) {
+    *(size_t *)ctx += len;
+    fb_stdout_sink(NULL, data, len);
+}
+
+static double elapsed_ms(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+// Draws the same cursor sweep with both backends and reports the cost per frame
+static void benchmark_renderers(int frames, int maxh, int maxw) {
+    UNIT army1[5], army2[5];
+    for (int i = 0; i < 5; i++) {
+        snprintf(army1[i].name, sizeof army1[i].name, "Blue%d", i + 1);
+        snprintf(army2[i].name, sizeof army2[i].name, "Red%d", i + 1);
+        army1[i].item1 = &items[0]; army1[i].item2 = &items[1]; army1[i].hp = 100 - i * 10;
+        army2[i].item1 = &items[10]; army2[i].item2 = NULL;     army2[i].hp = 50 + i * 10;
+    }
+
+    WINDOW *win = newwin(maxh - 4, maxw - 2, 2, 1);
+    Battlefield bf;
+    double ms[2];
+    size_t ansi_bytes = 0;
+
+    for (int backend = 0; backend < 2; backend++) {
+        clear();
+        refresh();
+        init_battlefield(&bf);
+        bf.main_win = win;
+        create_status_windows(&bf, maxh - 4, maxw - 2);
+        if (backend == 1) enable_ansi_renderer(&bf, LINES, COLS, counting_sink, &ansi_bytes);
+        for (int i = 0; i < 5; i++) {
+            place_unit(&bf, &army1[i], 1, 0, i * 2);
+            place_unit(&bf, &army2[i], 2, GRID_WIDTH - 1, i * 2);
+        }
+        set_game_state(&bf, STATE_SELECT_UNIT);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int f = 0; f < frames; f++) {
+            bf.cursor_pos.x = f % GRID_WIDTH;
+            bf.cursor_pos.y = (f / GRID_WIDTH) % GRID_HEIGHT;
+            update_all_displays(win, &bf, unit_at(&bf, bf.cursor_pos.x, bf.cursor_pos.y));
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ms[backend] = elapsed_ms(&start, &end);
+
+        disable_ansi_renderer(&bf);
+        destroy_status_windows(&bf);
+    }
+    delwin(win);
+    endwin();
+
+    printf("Renderer benchmark, %d frames at %dx%d\n", frames, maxw, maxh);
+    printf("  ncurses:     %8.2f ms total, %7.3f ms/frame\n", ms[0], ms[0] / frames);
+    printf("  framebuffer: %8.2f ms total, %7.3f ms/frame, %zu bytes/frame\n",
+           ms[1], ms[1] / frames, ansi_bytes / frames);
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --server PATH        Host matches on a UNIX domain socket\n");
+    printf("  --connect PATH       Play on a match server (creates a new match)\n");
+    printf("  --match ID           With --connect: attach to an existing match\n");
+    printf("  --team N             With --match: play as team 1/2, 3 for both, 0 to watch\n");
+    printf("  --loadtest PATH N    Play N concurrent matches against a server\n");
+    printf("  --ansi               Draw battles with the framebuffer renderer\n");
+    printf("  --record FILE        Record AI battles to an asciicast v2 file at full speed\n");
+    printf("  --simultaneous       AI battles: both armies plan together and act at once\n");
+    printf("  --fog                Fog of war: armies only see what their units see\n");
+    printf("  --map FILE           Battle on the terrain in FILE (walls, water, forest)\n");
+    printf("  --army1 SPEC         Army 1 from a file, or inline: \"Arthur: Sword, Shield; Robin: Bow\"\n");
+    printf("  --army2 SPEC         Army 2, same format\n");
+    printf("  --mode ai|simple     With both armies: start that game right away (default ai)\n");
+    printf("  --tournament ROSTER  Play every pair of armies in ROSTER and rank them by Elo\n");
+    printf("  --games K            With --tournament: games per pair (default 10)\n");
+    printf("  --jobs N             With --tournament: worker threads (default: one per core)\n");
+    printf("  --results FILE       With --tournament: results table (default tournament.txt)\n");
+    printf("  --bench-render N     Time N frames with the ncurses and framebuffer renderers\n");
+    printf("  --trace FILE         Write a Chrome/Perfetto trace of the run to FILE on exit\n");
+    printf("  --events FILE        Log every hit of the run's battles to FILE, by column\n");
+    printf("  --query FILE         Print per-item and per-matchup totals from an --events FILE\n");
+}
+
+// Records an AI battle to record_path and reports how long it took
+static void record_battle(WINDOW *logwin, UNIT a1[], int n1, UNIT a2[], int n2) {
+    werase(logwin);
+    CastRecorder *rec = cast_open(record_path, CAST_COLS, CAST_ROWS, "Battle Arena");
+    if (!rec) {
+        mvwprintw(logwin, 1, 2, "Could not open %s for recording", record_path);
+        wrefresh(logwin);
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    simulate_battle_curses(a1, n1, a2, n2, RECORD_MAX_ROUNDS, NULL, rec);
+    long long playback_us = rec->clock_us;
+    long frames = rec->events;
+    bool ok = cast_close(rec);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    mvwprintw(logwin, 1, 2, "%s %s: %ld frames, %lld.%01lld s of playback, written in %.1f ms",
+              ok ? "Recorded" : "Failed to write", record_path, frames,
+              playback_us / 1000000, (playback_us / 100000) % 10, elapsed_ms(&start, &end));
+    wrefresh(logwin);
+}
+
+// Runs one game with armies from the command line, skipping every menu
+static void play_scripted(int mode, const Army *a1, const Army *a2, int maxh, int maxw) {
+    UNIT army1[MAX_ARMY], army2[MAX_ARMY];
+    int c1 = a1->count, c2 = a2->count;
+    memcpy(army1, a1->units, sizeof(army1));
+    memcpy(army2, a2->units, sizeof(army2));
+
+    if (mode == MODE_SIMPLE) {
+        WINDOW *logwin = open_log_window(maxh, maxw, " Simple Game ");
+        simple_game_curses(army1, &c1, army2, &c2, NULL, logwin);
+        close_log_window(logwin);
+        return;
+    }
+
+    WINDOW *logwin = open_log_window(maxh, maxw, " Battle Log ");
+    if (record_path) {
+        record_battle(logwin, army1, c1, army2, c2);
+        mvwprintw(logwin, 3, 2, "Press any key to exit");
+        wrefresh(logwin);
+        wgetch(logwin);
+    } else {
+        simulate_battle_curses(army1, c1, army2, c2, -1, logwin, NULL);
+    }
+    close_log_window(logwin);
+}
+
 // This is where our game starts!
-int main() {
+int main(int argc, char *argv[]) {
+    // Command line options for the server and its clients
+    const char *server_path = NULL, *connect_path = NULL, *loadtest_path = NULL;
+    int match_id = 0, team = JOIN_BOTH, loadtest_matches = 0, bench_frames = 0;
+    TournamentOptions tournament = {NULL, "tournament.txt", 10, 0, false, false};
+    const char *army_spec[2] = {NULL, NULL}, *mode_name = NULL, *query_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connect_path = argv[++i];
+        } else if (strcmp(argv[i], "--match") == 0 && i + 1 < argc) {
+            match_id = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--team") == 0 && i + 1 < argc) {
+            team = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loadtest") == 0 && i + 2 < argc) {
+            loadtest_path = argv[++i];
+            loadtest_matches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--army1") == 0 && i + 1 < argc) {
+            army_spec[0] = argv[++i];
+        } else if (strcmp(argv[i], "--army2") == 0 && i + 1 < argc) {
+            army_spec[1] = argv[++i];
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode_name = argv[++i];
+        } else if (strcmp(argv[i], "--tournament") == 0 && i + 1 < argc) {
+            tournament.roster_path = argv[++i];
+        } else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc) {
+            tournament.games = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            tournament.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--results") == 0 && i + 1 < argc) {
+            tournament.results_path = argv[++i];
+        } else if (strcmp(argv[i], "--simultaneous") == 0) {
+            simultaneous_rounds = true;
+        } else if (strcmp(argv[i], "--fog") == 0) {
+            fog_of_war = true;
+        } else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) {
+            char err[256];
+            if (load_terrain(argv[++i], battle_terrain, MAX_GRID_WIDTH, MAX_GRID_HEIGHT,
+                             err, sizeof(err)) != 0) {
+                fprintf(stderr, "Map %s\n", err);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--ansi") == 0) {
+            use_ansi_renderer = true;
+        } else if (strcmp(argv[i], "--bench-render") == 0 && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            if (!trace_start(argv[++i])) {
+                fprintf(stderr, "Can't trace to %s\n", argv[i]);
+                return 1;
+            }
+            trace_thread_name("main");
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            if (!eventlog_start(argv[++i])) {
+                fprintf(stderr, "Can't log events to %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            query_path = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    // These never touch the terminal UI
+    if (server_path) return run_match_server(server_path);
+    if (loadtest_path) return run_load_test(loadtest_path, loadtest_matches);
+    if (query_path) return run_event_query(query_path);
+    if (tournament.roster_path) {
+        tournament.simultaneous = simultaneous_rounds;
+        tournament.fog = fog_of_war;
+        return run_tournament(&tournament);
+    }
+
+    // Armies given on the command line skip the menus and the setup prompts
+    Army scripted[2];
+    int scripted_mode = MODE_AI;
+    if (army_spec[0] || army_spec[1] || mode_name) {
+        if (!army_spec[0] || !army_spec[1]) {
+            fprintf(stderr, "--army1 and --army2 go together\n");
+            return 1;
+        }
+        if (mode_name && strcmp(mode_name, "simple") == 0) {
+            scripted_mode = MODE_SIMPLE;
+        } else if (mode_name && strcmp(mode_name, "ai") != 0) {
+            fprintf(stderr, "Unknown mode %s (use ai or simple)\n", mode_name);
+            return 1;
+        }
+        for (int i = 0; i < 2; i++) {
+            char err[256];
+            if (load_army(army_spec[i], &scripted[i], err, sizeof(err)) != 0) {
+                fprintf(stderr, "Army %d: %s\n", i + 1, err);
+                return 1;
+            }
+        }
+    }
+
     // Set up our terminal to handle special characters and colors
     setlocale(LC_ALL,"");
     initscr();              // Start up the terminal graphics
@@ -838,6 +1397,30 @@ int main() {
     init_pair(5, COLOR_CYAN, COLOR_BLACK);     // Menu highlight - Cyan on black
     init_pair(6, COLOR_WHITE, COLOR_BLACK);    // Normal text - White on black
     
+    if (bench_frames > 0) {
+        int maxh, maxw;
+        getmaxyx(stdscr, maxh, maxw);
+        benchmark_renderers(bench_frames, maxh, maxw);
+        return 0;
+    }
+
+    if (connect_path) {
+        int maxh, maxw;
+        getmaxyx(stdscr, maxh, maxw);
+        play_online(connect_path, match_id, team, maxh, maxw);
+        endwin();
+        return 0;
+    }
+
+    if (army_spec[0]) {
+        int maxh, maxw;
+        getmaxyx(stdscr, maxh, maxw);
+        play_scripted(scripted_mode, &scripted[0], &scripted[1], maxh, maxw);
+        popup_pool_free();
+        endwin();
+        return 0;
+    }
+
     // Load our cool ASCII art for the menu
     AsciiArt title = load_art(TITLE_FILE);     // Game title
     AsciiArt left = load_art(LEFT_ART_FILE);   // Left side decoration
@@ -883,15 +1466,8 @@ int main() {
             }
             else if (mode == MODE_AI) {
                 // They chose AI game mode
-                clear();
                 int lh = maxh - 4, lw = maxw - 2;
-                WINDOW *logwin = newwin(lh, lw, 2, 1);
-                box(stdscr, 0, 0);
-                mvprintw(1, (maxw-12)/2, " Battle Log ");
-                wrefresh(stdscr);
-
-                scrollok(logwin, TRUE);
-                werase(logwin);
+                WINDOW *logwin = open_log_window(maxh, maxw, " Battle Log ");
 
                 // Set up both armies
                 UNIT army1[5], army2[5];
@@ -906,8 +1482,12 @@ int main() {
                     wrefresh(logwin);
                     wgetch(logwin);
                 } else {
-                    // Start the AI battle!
-                    simulate_battle_curses(army1, c1, army2, c2, -1, logwin);
+                    // Start the AI battle! (or record it straight to a file)
+                    if (record_path) {
+                        record_battle(logwin, army1, c1, army2, c2);
+                    } else {
+                        simulate_battle_curses(army1, c1, army2, c2, -1, logwin, NULL);
+                    }
                     
                     // Show end game options
                     const char *opts[] = { "Main Menu", "Exit" };
@@ -932,29 +1512,23 @@ int main() {
                     
                     // Handle their choice
                     if(selb == 1) {
-                        delwin(logwin);
+                        close_log_window(logwin);
+                        popup_pool_free();
                         endwin();
                         exit(0);
                     }
                 }
                 
                 // Clean up and go back to main menu
-                delwin(logwin);
+                close_log_window(logwin);
+                getmaxyx(stdscr, maxh, maxw);  // The terminal may have been resized in game
                 draw_base(maxh, maxw, &title, &left, &right, btn);
                 sel = 0;
                 for(int i = 0; i < BTN_COUNT; i++)
                     draw_button(btn[i], labels[i], i == sel);
             }
             else if (mode == MODE_SIMPLE) {
-                clear();
-                int lh = maxh - 4, lw = maxw - 2;
-                WINDOW *logwin = newwin(lh, lw, 2, 1);
-                box(stdscr, 0, 0);
-                mvprintw(1, (maxw-12)/2, " Simple Game ");
-                wrefresh(stdscr);
-
-                scrollok(logwin, TRUE);
-                werase(logwin);
+                WINDOW *logwin = open_log_window(maxh, maxw, " Simple Game ");
                 int y=1, err;
                 UNIT army1[5], army2[5]; int c1,c2;
                 if ((err = read_army_curses(logwin, &y, army1, &c1)) < 0 ||
@@ -964,28 +1538,26 @@ int main() {
                     wrefresh(logwin);
                     wgetch(logwin);
                 } else {
-                    simple_game_curses(army1,&c1,army2,&c2,1,logwin);
+                    simple_game_curses(army1,&c1,army2,&c2,NULL,logwin);
                 }
-                delwin(logwin);
+                close_log_window(logwin);
+                getmaxyx(stdscr, maxh, maxw);  // The terminal may have been resized in game
                 draw_base(maxh,maxw,&title,&left,&right,btn); sel=0; for(int i=0;i<BTN_COUNT;i++) draw_button(btn[i], labels[i], i==sel);
             }
             else if(mode==MODE_LOAD){
-                clear();
-                int lh = maxh - 4, lw = maxw - 2;
-                WINDOW *logwin = newwin(lh, lw, 2, 1);
-                box(stdscr, 0, 0);
-                mvprintw(1, (maxw-12)/2, " Load Game ");
-                wrefresh(stdscr);
+                WINDOW *logwin = open_log_window(maxh, maxw, " Load Game ");
 
                 UNIT army1[5], army2[5]; int c1,c2, turn_s;
-                if(load_game(SAVE_FILE, army1,&c1, army2,&c2, &turn_s)){
+                BattleState saved; bool has_state;
+                if(load_game(SAVE_FILE, army1,&c1, army2,&c2, &turn_s, &saved, &has_state)){
                     mvwprintw(logwin,1,2,"Game loaded! Press any key to continue…"); wrefresh(logwin); wgetch(logwin);
                     werase(logwin);
-                    simple_game_curses(army1,&c1,army2,&c2,turn_s,logwin);
+                    simple_game_curses(army1,&c1,army2,&c2,has_state ? &saved : NULL,logwin);
                 } else {
                     mvwprintw(logwin,1,2,"Load failed. Press any key…"); wrefresh(logwin); wgetch(logwin);
                 }
-                delwin(logwin);
+                close_log_window(logwin);
+                getmaxyx(stdscr, maxh, maxw);  // The terminal may have been resized in game
                 draw_base(maxh,maxw,&title,&left,&right,btn); sel=0; for(int i=0;i<BTN_COUNT;i++) draw_button(btn[i], labels[i], i==sel);
             }
         }
@@ -995,58 +1567,7 @@ int main() {
 
     for(int i=0;i<BTN_COUNT;i++) if(btn[i]) delwin(btn[i]);
     free_art(&title); free_art(&left); free_art(&right);
+    popup_pool_free();
     endwin();
     return 0;
 }
-
-// Add new function to find closest enemy
-static Position find_closest_enemy(const Battlefield *bf, int team, int x, int y) {
-    Position closest = {-1, -1};
-    int min_dist = MAX_GRID_WIDTH + MAX_GRID_HEIGHT;
-    
-    int enemy_team = (team == 1) ? 1 : 0;  // enemy_team index is team-1
-    for (int i = 0; i < bf->unit_counts[enemy_team]; i++) {
-        const Position *enemy_pos = &bf->positions[enemy_team][i];
-        int dist = manhattan_distance(x, y, enemy_pos->x, enemy_pos->y);
-        if (dist < min_dist) {
-            min_dist = dist;
-            closest.x = enemy_pos->x;
-            closest.y = enemy_pos->y;
-        }
-    }
-    return closest;
-}
-
-// This function helps a unit move closer to their target
-static bool move_towards_target(Battlefield *bf, Position *unit_pos, Position target) {
-    // If we're already at the target, we can't move closer!
-    if (unit_pos->x == target.x && unit_pos->y == target.y)
-        return false;
-    
-    // Figure out which direction we need to go
-    int dx = (target.x > unit_pos->x) ? 1 : (target.x < unit_pos->x) ? -1 : 0;
-    int dy = (target.y > unit_pos->y) ? 1 : (target.y < unit_pos->y) ? -1 : 0;
-    
-    // Try moving horizontally first
-    if (dx != 0 && is_valid_move(bf, unit_pos->x, unit_pos->y,
-                                unit_pos->x + dx, unit_pos->y)) {
-        // Move the unit one square left or right
-        move_unit(bf, unit_pos->x, unit_pos->y,
-                 unit_pos->x + dx, unit_pos->y);
-        unit_pos->x += dx;
-        return true;
-    }
-    
-    // If we can't move horizontally, try moving vertically
-    if (dy != 0 && is_valid_move(bf, unit_pos->x, unit_pos->y,
-                                unit_pos->x, unit_pos->y + dy)) {
-        // Move the unit one square up or down
-        move_unit(bf, unit_pos->x, unit_pos->y,
-                 unit_pos->x, unit_pos->y + dy);
-        unit_pos->y += dy;
-        return true;
-    }
-    
-    // If we get here, we couldn't move closer to the target
-    return false;
-}
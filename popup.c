@@ -0,0 +1,74 @@
+#include <panel.h>
+#include "popup.h"
+
+static PANEL *popups[POPUP_KINDS];
+static PANEL *underlays[POPUP_MAX_UNDERLAYS];
+
+WINDOW *popup_open(PopupKind kind, int height, int width, int y, int x) {
+    PANEL *panel = popups[kind];
+    if (panel) {
+        WINDOW *win = panel_window(panel);
+        int h, w;
+        getmaxyx(win, h, w);
+        if (h != height || w != width) {
+            // A different size needs a new window; this only happens when
+            // the same kind of popup is shown at another size
+            del_panel(panel);
+            delwin(win);
+            panel = popups[kind] = NULL;
+        } else {
+            move_panel(panel, y, x);
+        }
+    }
+    if (!panel) {
+        WINDOW *win = newwin(height, width, y, x);
+        if (!win) return NULL;
+        keypad(win, TRUE);
+        panel = popups[kind] = new_panel(win);
+    }
+
+    show_panel(panel);
+    top_panel(panel);
+    werase(panel_window(panel));
+    return panel_window(panel);
+}
+
+void popup_close(PopupKind kind) {
+    if (!popups[kind] || panel_hidden(popups[kind])) return;
+    hide_panel(popups[kind]);
+    update_panels();
+    doupdate();
+}
+
+void popup_attach(WINDOW *win) {
+    int free_slot = -1;
+    for (int i = 0; i < POPUP_MAX_UNDERLAYS; i++) {
+        if (underlays[i] && panel_window(underlays[i]) == win) return;
+        if (!underlays[i] && free_slot < 0) free_slot = i;
+    }
+    if (free_slot < 0) return;
+    underlays[free_slot] = new_panel(win);
+    // New panels go on top; an open popup has to stay above them
+    for (int k = 0; k < POPUP_KINDS; k++) {
+        if (popups[k] && !panel_hidden(popups[k])) top_panel(popups[k]);
+    }
+}
+
+void popup_detach(WINDOW *win) {
+    for (int i = 0; i < POPUP_MAX_UNDERLAYS; i++) {
+        if (underlays[i] && panel_window(underlays[i]) == win) {
+            del_panel(underlays[i]);
+            underlays[i] = NULL;
+        }
+    }
+}
+
+void popup_pool_free(void) {
+    for (int k = 0; k < POPUP_KINDS; k++) {
+        if (!popups[k]) continue;
+        WINDOW *win = panel_window(popups[k]);
+        del_panel(popups[k]);
+        delwin(win);
+        popups[k] = NULL;
+    }
+}
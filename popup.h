@@ -0,0 +1,31 @@
+#ifndef POPUP_H
+#define POPUP_H
+
+#include <ncurses.h>
+
+// Popups that come and go over the game screen. Each kind owns one window
+// that is kept for the whole run and stacked with the panel library, so
+// showing a popup again reuses its window, and hiding it repaints only the
+// cells it covered from the windows underneath.
+typedef enum {
+    POPUP_ACTION_MENU,
+    POPUP_ITEM_MENU,
+    POPUP_COMBAT_LOG,
+    POPUP_KINDS
+} PopupKind;
+
+#define POPUP_MAX_UNDERLAYS 16
+
+// Shows the popup at the given place, creating its window the first time
+WINDOW *popup_open(PopupKind kind, int height, int width, int y, int x);
+// Hides it and restores what was beneath it
+void popup_close(PopupKind kind);
+
+// Windows popups may cover. Only these (and stdscr) are restored on close,
+// and a window must be detached before it is deleted.
+void popup_attach(WINDOW *win);
+void popup_detach(WINDOW *win);
+
+void popup_pool_free(void);
+
+#endif // POPUP_H
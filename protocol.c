@@ -0,0 +1,171 @@
+#include <string.h>
+#include "protocol.h"
+
+// Small cursor over a payload so the encoders/decoders stay bounds-checked
+typedef struct {
+    uint8_t *buf;
+    size_t cap, pos;
+    bool ok;
+} Writer;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len, pos;
+    bool ok;
+} Reader;
+
+static void put_u8(Writer *w, uint8_t v) {
+    if (w->pos + 1 > w->cap) { w->ok = false; return; }
+    w->buf[w->pos++] = v;
+}
+
+static void put_str(Writer *w, const char *s, size_t max) {
+    size_t n = strnlen(s, max);
+    put_u8(w, (uint8_t)n);
+    if (w->pos + n > w->cap) { w->ok = false; return; }
+    memcpy(w->buf + w->pos, s, n);
+    w->pos += n;
+}
+
+static uint8_t get_u8(Reader *r) {
+    if (r->pos + 1 > r->len) { r->ok = false; return 0; }
+    return r->buf[r->pos++];
+}
+
+static void get_str(Reader *r, char *out, size_t max) {
+    size_t n = get_u8(r);
+    if (n > max || r->pos + n > r->len) { r->ok = false; out[0] = '\0'; return; }
+    memcpy(out, r->buf + r->pos, n);
+    out[n] = '\0';
+    r->pos += n;
+}
+
+static uint8_t wire_item(const ITEM *it) {
+    int idx = item_index(it);
+    return idx < 0 ? PROTO_NO_ITEM : (uint8_t)idx;
+}
+
+static const ITEM *catalog_item(uint8_t idx) {
+    return idx < NUMBER_OF_ITEMS ? &items[idx] : NULL;
+}
+
+size_t proto_write_header(uint8_t *buf, uint8_t type, uint16_t match_id, uint16_t len) {
+    buf[0] = type;
+    buf[1] = match_id & 0xFF;
+    buf[2] = match_id >> 8;
+    buf[3] = len & 0xFF;
+    buf[4] = len >> 8;
+    return PROTO_HEADER_SIZE;
+}
+
+bool proto_read_header(const uint8_t *buf, size_t avail, MessageHeader *hdr) {
+    if (avail < PROTO_HEADER_SIZE) return false;
+    hdr->type = buf[0];
+    hdr->match_id = buf[1] | (buf[2] << 8);
+    hdr->len = buf[3] | (buf[4] << 8);
+    return true;
+}
+
+static void put_army(Writer *w, const UNIT army[], int n) {
+    put_u8(w, (uint8_t)n);
+    for (int i = 0; i < n; i++) {
+        put_u8(w, wire_item(army[i].item1));
+        put_u8(w, wire_item(army[i].item2));
+        put_str(w, army[i].name, PROTO_NAME_MAX);
+    }
+}
+
+static void get_army(Reader *r, UNIT army[], int *n) {
+    *n = get_u8(r);
+    if (*n < MIN_ARMY || *n > MAX_ARMY) { r->ok = false; return; }
+    for (int i = 0; i < *n && r->ok; i++) {
+        UNIT *u = &army[i];
+        memset(u, 0, sizeof *u);
+        u->item1 = catalog_item(get_u8(r));
+        u->item2 = catalog_item(get_u8(r));
+        get_str(r, u->name, PROTO_NAME_MAX);
+        u->hp = 100;
+
+        // Same rules as the interactive setup: a primary item and at most two slots
+        int slots = (u->item1 ? u->item1->slots : 0) + (u->item2 ? u->item2->slots : 0);
+        if (!u->item1 || slots > 2) r->ok = false;
+    }
+}
+
+size_t proto_encode_armies(uint8_t *buf, size_t cap,
+                           const UNIT a1[], int n1, const UNIT a2[], int n2) {
+    Writer w = {buf, cap, 0, true};
+    put_army(&w, a1, n1);
+    put_army(&w, a2, n2);
+    return w.ok ? w.pos : 0;
+}
+
+bool proto_decode_armies(const uint8_t *buf, size_t len,
+                         UNIT a1[], int *n1, UNIT a2[], int *n2) {
+    Reader r = {buf, len, 0, true};
+    get_army(&r, a1, n1);
+    get_army(&r, a2, n2);
+    return r.ok && r.pos == len;
+}
+
+size_t proto_encode_action(uint8_t *buf, size_t cap, const NetAction *act) {
+    Writer w = {buf, cap, 0, true};
+    put_u8(&w, act->kind);
+    put_u8(&w, act->from_x);
+    put_u8(&w, act->from_y);
+    put_u8(&w, act->to_x);
+    put_u8(&w, act->to_y);
+    return w.ok ? w.pos : 0;
+}
+
+bool proto_decode_action(const uint8_t *buf, size_t len, NetAction *act) {
+    Reader r = {buf, len, 0, true};
+    act->kind = get_u8(&r);
+    act->from_x = get_u8(&r);
+    act->from_y = get_u8(&r);
+    act->to_x = get_u8(&r);
+    act->to_y = get_u8(&r);
+    return r.ok && r.pos == len;
+}
+
+size_t proto_encode_state(uint8_t *buf, size_t cap, const NetState *st) {
+    Writer w = {buf, cap, 0, true};
+    put_u8(&w, st->turn);
+    put_u8(&w, st->winner);
+    put_u8(&w, st->count);
+    for (int i = 0; i < st->count; i++) {
+        const NetUnit *u = &st->units[i];
+        put_u8(&w, u->team);
+        put_u8(&w, u->x);
+        put_u8(&w, u->y);
+        put_u8(&w, u->hp);
+        put_u8(&w, u->item1);
+        put_u8(&w, u->item2);
+        put_str(&w, u->name, PROTO_NAME_MAX);
+    }
+    put_str(&w, st->message, PROTO_MESSAGE_MAX);
+    // Keep the payload length field honest
+    if (w.pos > PROTO_MAX_PAYLOAD) return 0;
+    return w.ok ? w.pos : 0;
+}
+
+bool proto_decode_state(const uint8_t *buf, size_t len, NetState *st) {
+    Reader r = {buf, len, 0, true};
+    st->turn = get_u8(&r);
+    st->winner = get_u8(&r);
+    st->count = get_u8(&r);
+    if (st->count > 2 * MAX_ARMY) return false;
+    for (int i = 0; i < st->count && r.ok; i++) {
+        NetUnit *u = &st->units[i];
+        u->team = get_u8(&r);
+        u->x = get_u8(&r);
+        u->y = get_u8(&r);
+        u->hp = get_u8(&r);
+        u->item1 = get_u8(&r);
+        u->item2 = get_u8(&r);
+        get_str(&r, u->name, PROTO_NAME_MAX);
+        if (u->team < 1 || u->team > 2 || u->item1 >= NUMBER_OF_ITEMS) r.ok = false;
+    }
+    get_str(&r, st->message, PROTO_MESSAGE_MAX);
+    return r.ok && r.pos == len;
+}
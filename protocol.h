@@ -0,0 +1,87 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "data.h"
+
+// Wire format shared by the match server and its clients.
+// Every frame is a 5 byte header followed by a little-endian payload:
+//   u8 type | u16 match id | u16 payload length
+#define PROTO_HEADER_SIZE   5
+#define PROTO_MAX_PAYLOAD   1024
+#define PROTO_MAX_FRAME     (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD)
+#define PROTO_NO_ITEM       0xFF
+#define PROTO_NAME_MAX      24    // Unit names are truncated to this on the wire
+#define PROTO_MESSAGE_MAX   80    // Last combat message carried in a state frame
+
+// Teams a client can join as
+#define JOIN_SPECTATE 0
+#define JOIN_BOTH     3
+
+typedef enum {
+    MSG_CREATE = 1,   // client -> server: both armies, answered with MSG_CREATED
+    MSG_CREATED,      // server -> client: match id in the header, empty payload
+    MSG_JOIN,         // client -> server: u8 team (1, 2, JOIN_BOTH or JOIN_SPECTATE)
+    MSG_ACTION,       // client -> server: u8 kind, u8 from_x, from_y, to_x, to_y
+    MSG_STATE,        // server -> client: full match snapshot
+    MSG_ERROR         // server -> client: u8 NetError
+} MessageType;
+
+typedef enum {
+    NET_ACT_MOVE,
+    NET_ACT_ATTACK,
+    NET_ACT_END_TURN
+} NetActionKind;
+
+typedef enum {
+    NET_OK,
+    NET_ERR_PROTOCOL,
+    NET_ERR_NO_MATCH,
+    NET_ERR_POOL_FULL,
+    NET_ERR_NOT_YOUR_TURN,
+    NET_ERR_INVALID_ACTION
+} NetError;
+
+typedef struct {
+    uint8_t type;
+    uint16_t match_id;
+    uint16_t len;
+} MessageHeader;
+
+typedef struct {
+    uint8_t kind;
+    uint8_t from_x, from_y;
+    uint8_t to_x, to_y;
+} NetAction;
+
+typedef struct {
+    uint8_t team;
+    uint8_t x, y;
+    uint8_t hp;
+    uint8_t item1, item2;      // Catalog indices or PROTO_NO_ITEM
+    char name[PROTO_NAME_MAX + 1];
+} NetUnit;
+
+typedef struct {
+    uint8_t turn;              // Team to act next
+    uint8_t winner;            // 0 while the match is running
+    uint8_t count;
+    NetUnit units[2 * MAX_ARMY];
+    char message[PROTO_MESSAGE_MAX + 1];
+} NetState;
+
+// Frame helpers; encoders return the number of bytes written or 0 if it didn't fit
+size_t proto_write_header(uint8_t *buf, uint8_t type, uint16_t match_id, uint16_t len);
+bool proto_read_header(const uint8_t *buf, size_t avail, MessageHeader *hdr);
+size_t proto_encode_armies(uint8_t *buf, size_t cap,
+                           const UNIT a1[], int n1, const UNIT a2[], int n2);
+bool proto_decode_armies(const uint8_t *buf, size_t len,
+                         UNIT a1[], int *n1, UNIT a2[], int *n2);
+size_t proto_encode_action(uint8_t *buf, size_t cap, const NetAction *act);
+bool proto_decode_action(const uint8_t *buf, size_t len, NetAction *act);
+size_t proto_encode_state(uint8_t *buf, size_t cap, const NetState *st);
+bool proto_decode_state(const uint8_t *buf, size_t len, NetState *st);
+
+#endif // PROTOCOL_H
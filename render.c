@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "render.h"
+#include "trace.h"
+
+// Box drawing glyphs used in place of the ncurses ACS characters
+#define GLYPH_HLINE    0x2500
+#define GLYPH_VLINE    0x2502
+#define GLYPH_ULCORNER 0x250C
+#define GLYPH_URCORNER 0x2510
+#define GLYPH_LLCORNER 0x2514
+#define GLYPH_LRCORNER 0x2518
+#define GLYPH_LARROW   0x2190
+#define GLYPH_UARROW   0x2191
+#define GLYPH_RARROW   0x2192
+#define GLYPH_DARROW   0x2193
+#define GLYPH_SHADE    0x2591
+
+// ANSI foreground colors matching the init_pair table in main.c
+static const int pair_fg[] = { 39, 34, 31, 33, 32, 36, 37 };
+
+void fb_stdout_sink(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n <= 0) return;
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+bool fb_init(Framebuffer *fb, int rows, int cols, RenderSink sink, void *sink_ctx) {
+    memset(fb, 0, sizeof *fb);
+    fb->rows = rows;
+    fb->cols = cols;
+    fb->front = calloc((size_t)rows * cols, sizeof(FbCell));
+    fb->back = calloc((size_t)rows * cols, sizeof(FbCell));
+    fb->out_cap = (size_t)rows * cols * 4 + 256;
+    fb->out = malloc(fb->out_cap);
+    fb->sink = sink ? sink : fb_stdout_sink;
+    fb->sink_ctx = sink_ctx;
+    if (!fb->front || !fb->back || !fb->out) {
+        fb_free(fb);
+        return false;
+    }
+    fb_clear(fb);
+    return true;
+}
+
+void fb_free(Framebuffer *fb) {
+    free(fb->front);
+    free(fb->back);
+    free(fb->out);
+    memset(fb, 0, sizeof *fb);
+}
+
+void fb_clear(Framebuffer *fb) {
+    int n = fb->rows * fb->cols;
+    for (int i = 0; i < n; i++) {
+        fb->back[i] = (FbCell){' ', 0, 0};
+    }
+}
+
+void fb_invalidate(Framebuffer *fb) {
+    fb->valid = false;
+}
+
+void fb_put(Framebuffer *fb, int y, int x, uint32_t glyph, int style) {
+    if (y < 0 || y >= fb->rows || x < 0 || x >= fb->cols) return;
+    FbCell *c = &fb->back[y * fb->cols + x];
+    c->glyph = glyph;
+    c->color = style & 0xFF;
+    c->attrs = (style >> 8) & 0xFF;
+}
+
+// Decodes one UTF-8 sequence and advances *s past it
+static uint32_t utf8_next(const char **s) {
+    const unsigned char *p = (const unsigned char *)*s;
+    uint32_t cp;
+    int extra;
+    if (p[0] < 0x80)      { cp = p[0];        extra = 0; }
+    else if (p[0] < 0xE0) { cp = p[0] & 0x1F; extra = 1; }
+    else if (p[0] < 0xF0) { cp = p[0] & 0x0F; extra = 2; }
+    else                  { cp = p[0] & 0x07; extra = 3; }
+    p++;
+    for (int i = 0; i < extra && (*p & 0xC0) == 0x80; i++, p++) {
+        cp = (cp << 6) | (*p & 0x3F);
+    }
+    *s = (const char *)p;
+    return cp;
+}
+
+static size_t utf8_encode(uint32_t cp, char *out) {
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+static void fb_vprint(Framebuffer *fb, int y, int x, int max_cols, int style,
+                      const char *format, va_list args) {
+    char buf[256];
+    vsnprintf(buf, sizeof buf, format, args);
+    const char *p = buf;
+    for (int i = 0; *p && i < max_cols; i++) {
+        fb_put(fb, y, x + i, utf8_next(&p), style);
+    }
+}
+
+void fb_print(Framebuffer *fb, int y, int x, int style, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fb_vprint(fb, y, x, fb->cols - x, style, format, args);
+    va_end(args);
+}
+
+void fb_hline(Framebuffer *fb, int y, int x, uint32_t glyph, int n, int style) {
+    for (int i = 0; i < n; i++) fb_put(fb, y, x + i, glyph, style);
+}
+
+void fb_vline(Framebuffer *fb, int y, int x, uint32_t glyph, int n, int style) {
+    for (int i = 0; i < n; i++) fb_put(fb, y + i, x, glyph, style);
+}
+
+void fb_box(Framebuffer *fb, int y, int x, int height, int width, int style) {
+    fb_hline(fb, y, x, GLYPH_HLINE, width, style);
+    fb_hline(fb, y + height - 1, x, GLYPH_HLINE, width, style);
+    fb_vline(fb, y, x, GLYPH_VLINE, height, style);
+    fb_vline(fb, y, x + width - 1, GLYPH_VLINE, height, style);
+    fb_put(fb, y, x, GLYPH_ULCORNER, style);
+    fb_put(fb, y, x + width - 1, GLYPH_URCORNER, style);
+    fb_put(fb, y + height - 1, x, GLYPH_LLCORNER, style);
+    fb_put(fb, y + height - 1, x + width - 1, GLYPH_LRCORNER, style);
+}
+
+static void out_append(Framebuffer *fb, const char *data, size_t len) {
+    if (fb->out_len + len > fb->out_cap) {
+        size_t cap = fb->out_cap * 2;
+        while (cap < fb->out_len + len) cap *= 2;
+        char *grown = realloc(fb->out, cap);
+        if (!grown) return;
+        fb->out = grown;
+        fb->out_cap = cap;
+    }
+    memcpy(fb->out + fb->out_len, data, len);
+    fb->out_len += len;
+}
+
+static void out_style(Framebuffer *fb, const FbCell *c) {
+    char seq[32];
+    int n = snprintf(seq, sizeof seq, "\x1b[0;%d%s%s%sm",
+                     pair_fg[c->color < 7 ? c->color : 0],
+                     (c->attrs & FB_BOLD) ? ";1" : "",
+                     (c->attrs & FB_DIM) ? ";2" : "",
+                     (c->attrs & FB_REVERSE) ? ";7" : "");
+    out_append(fb, seq, (size_t)n);
+}
+
+size_t fb_present(Framebuffer *fb) {
+    static const FbCell blank = {' ', 0, 0};
+    fb->out_len = 0;
+
+    if (!fb->valid) {
+        // Start from a known-blank terminal and treat every cell as dirty
+        out_append(fb, "\x1b[0m\x1b[2J", 8);
+        int n = fb->rows * fb->cols;
+        for (int i = 0; i < n; i++) fb->front[i] = blank;
+    }
+
+    int cur_y = -1, cur_x = -1;
+    FbCell cur_style = {0, 0xFF, 0xFF};   // Unknown, forces the first SGR
+
+    for (int y = 0; y < fb->rows; y++) {
+        for (int x = 0; x < fb->cols; x++) {
+            int i = y * fb->cols + x;
+            const FbCell *c = &fb->back[i];
+            if (memcmp(c, &fb->front[i], sizeof *c) == 0) continue;
+
+            if (y != cur_y || x != cur_x) {
+                char seq[24];
+                int n = snprintf(seq, sizeof seq, "\x1b[%d;%dH", y + 1, x + 1);
+                out_append(fb, seq, (size_t)n);
+            }
+            if (c->color != cur_style.color || c->attrs != cur_style.attrs) {
+                out_style(fb, c);
+                cur_style = *c;
+            }
+            char utf8[4];
+            out_append(fb, utf8, utf8_encode(c->glyph, utf8));
+            fb->front[i] = *c;
+            cur_y = y;
+            cur_x = x + 1;
+        }
+    }
+
+    if (fb->out_len > 0) {
+        out_append(fb, "\x1b[0m", 4);
+        fb->sink(fb->sink_ctx, fb->out, fb->out_len);
+    }
+    fb->valid = true;
+    return fb->out_len;
+}
+
+// ---------------------------------------------------------------------------
+// Battlefield drawing. Mirrors the ncurses functions in battlefield.c.
+
+// Prints inside a panel, clipped to its border like an ncurses subwindow
+static void panel_print(AnsiRenderer *r, const Rect *rect, int row, int col, int style,
+                        const char *format, ...) {
+    if (row < 0 || row >= rect->height) return;
+    va_list args;
+    va_start(args, format);
+    fb_vprint(&r->fb, rect->y + row, rect->x + col, rect->width - col, style, format, args);
+    va_end(args);
+}
+
+static void panel_frame(AnsiRenderer *r, const Rect *rect, const char *title) {
+    fb_box(&r->fb, rect->y, rect->x, rect->height, rect->width, 0);
+    panel_print(r, rect, 0, 2, 0, "%s", title);
+}
+
+static void cell_border(AnsiRenderer *r, const Battlefield *bf, int x, int y, int style, bool corners) {
+    const GridDimensions *dims = &bf->grid_dims;
+    int px, py;
+    if (!grid_cell_origin(dims, x, y, &px, &py)) return;
+    px += r->origin_x;
+    py += r->origin_y;
+    if (corners) {
+        fb_box(&r->fb, py, px, dims->cell_height, dims->cell_width, style);
+    } else {
+        fb_hline(&r->fb, py, px, GLYPH_HLINE, dims->cell_width, style);
+        fb_hline(&r->fb, py + dims->cell_height - 1, px, GLYPH_HLINE, dims->cell_width, style);
+        fb_vline(&r->fb, py, px, GLYPH_VLINE, dims->cell_height, style);
+        fb_vline(&r->fb, py, px + dims->cell_width - 1, GLYPH_VLINE, dims->cell_height, style);
+    }
+}
+
+static void render_grid(AnsiRenderer *r, const Battlefield *bf) {
+    const GridDimensions *dims = &bf->grid_dims;
+    Bitboard view = fog_view(bf);
+
+    for (int y = dims->view_y; y < dims->view_y + dims->height; y++) {
+        for (int x = dims->view_x; x < dims->view_x + dims->width; x++) {
+            int px = r->origin_x + dims->start_x + (x - dims->view_x) * dims->cell_width;
+            int py = r->origin_y + dims->start_y + (y - dims->view_y) * dims->cell_height;
+            const TerrainInfo *ground = &terrain_info[bf->terrain[y][x]];
+            bool seen = (view & cell_bit(x, y)) != 0;
+            int style = FB_STYLE(ground->color, seen ? 0 : FB_DIM);
+            cell_border(r, bf, x, y, style, true);
+            if (!seen || (bf->terrain[y][x] != TERRAIN_PLAIN && !bf->cells[y][x].handle)) {
+                uint32_t fill = bf->terrain[y][x] == TERRAIN_PLAIN ? GLYPH_SHADE : (uint32_t)ground->glyph;
+                for (int row = 1; row < dims->cell_height - 1; row++) {
+                    fb_hline(&r->fb, py + row, px + 1, fill, dims->cell_width - 2, style);
+                }
+            }
+            if (!seen) continue;
+
+            const UnitSlot *slot = slot_at(bf, x, y);
+            if (!slot) continue;
+            int name_width = dims->cell_width - 2;
+            fb_print(&r->fb, py + 1, px + 1, FB_STYLE(slot->team, 0), "%-*.*s",
+                     name_width, name_width, slot->unit->name);
+
+            int hp_width = (slot->unit->hp * (dims->cell_width - 2)) / 100;
+            fb_hline(&r->fb, py + 2, px + 1, ' ', hp_width, FB_STYLE(slot->team, FB_REVERSE));
+        }
+    }
+
+    int left = r->origin_x + dims->start_x, top = r->origin_y + dims->start_y;
+    int right = left + dims->width * dims->cell_width;
+    int bottom = top + dims->height * dims->cell_height;
+    if (dims->view_x > 0) fb_put(&r->fb, top + 1, left - 1, GLYPH_LARROW, 0);
+    if (dims->view_x + dims->width < MAX_GRID_WIDTH) fb_put(&r->fb, top + 1, right, GLYPH_RARROW, 0);
+    if (dims->view_y > 0) fb_put(&r->fb, top - 1, left + 1, GLYPH_UARROW, 0);
+    if (dims->view_y + dims->height < MAX_GRID_HEIGHT) fb_put(&r->fb, bottom, left + 1, GLYPH_DARROW, 0);
+
+    if (bf->has_selection) {
+        const UNIT *selected = unit_at(bf, bf->selected_pos.x, bf->selected_pos.y);
+        int sx = bf->selected_pos.x, sy = bf->selected_pos.y;
+        Bitboard cells = 0;
+        int color = 0;
+        if (selected && bf->state == STATE_MOVE_UNIT) {
+            cells = move_targets(bf, sx, sy);
+            color = 1;
+        } else if (selected && selected->item1 && bf->state == STATE_SELECT_TARGET) {
+            cells = line_of_sight_cells(bf, sx, sy, unit_range(selected));
+            color = 3;
+        }
+        cells &= grid_view_mask(dims);
+        while (cells) {
+            int cell = bb_pop(&cells);
+            cell_border(r, bf, cell % MAX_GRID_WIDTH, cell / MAX_GRID_WIDTH, FB_STYLE(color, FB_DIM), false);
+        }
+        cell_border(r, bf, sx, sy, FB_STYLE(4, FB_BOLD), true);
+    }
+
+    cell_border(r, bf, bf->cursor_pos.x, bf->cursor_pos.y, FB_STYLE(3, FB_BOLD), true);
+}
+
+static void render_status(AnsiRenderer *r, const Battlefield *bf) {
+    const Rect *rect = &bf->layout.status;
+    const UNIT *u = r->selected;
+    panel_frame(r, rect, " Unit Info ");
+
+    if (u) {
+        panel_print(r, rect, 2, 2, FB_STYLE(0, FB_BOLD), "Name: %s", u->name);
+        int color = u->hp > 66 ? 1 : u->hp > 33 ? 3 : 2;
+        panel_print(r, rect, 3, 2, FB_STYLE(color, 0), "HP: %d/100", u->hp);
+        if (u->item1) {
+            panel_print(r, rect, 4, 2, 0, "Item 1: %s", u->item1->name);
+            panel_print(r, rect, 5, 4, 0, "ATT:%d DEF:%d RNG:%d",
+                        u->item1->att, u->item1->def, u->item1->range);
+        }
+        if (u->item2) {
+            panel_print(r, rect, 6, 2, 0, "Item 2: %s", u->item2->name);
+            panel_print(r, rect, 7, 4, 0, "ATT:%d DEF:%d RNG:%d",
+                        u->item2->att, u->item2->def, u->item2->range);
+        }
+    }
+
+    const Position *cur = &bf->cursor_pos;
+    panel_print(r, rect, 9, 2, 0, "Position: (%d,%d) %s", cur->x, cur->y,
+                terrain_info[bf->terrain[cur->y][cur->x]].name);
+    const UnitSlot *slot = slot_at(bf, cur->x, cur->y);
+    if (slot && !fog_hides(bf, cur->x, cur->y)) {
+        panel_print(r, rect, 10, 2, 0, "Unit here: %s", slot->unit->name);
+        panel_print(r, rect, 11, 2, 0, "Team: %d  HP: %d", slot->team, slot->unit->hp);
+    }
+}
+
+static void render_unit_list(AnsiRenderer *r, Battlefield *bf) {
+    const Rect *rect = &bf->layout.unit_list;
+    UnitListView *view = &bf->unit_list;
+    int visible = rect->height - 2;
+    unit_list_sync(bf);
+    unit_list_scroll(bf, 0, visible);
+
+    fb_box(&r->fb, rect->y, rect->x, rect->height, rect->width, 0);
+    panel_print(r, rect, 0, 2, 0, " Unit List (%s) ", unit_list_sort_name(view->sort));
+    for (int i = 0; i < visible; i++) {
+        UnitListRow row;
+        if (!unit_list_row(bf, view->scroll + i, &row)) break;
+        panel_print(r, rect, 1 + i, row.indent, FB_STYLE(row.color, 0), "%.*s",
+                    rect->width - row.indent - 1, row.text);
+    }
+    if (view->scroll > 0) fb_put(&r->fb, rect->y + 1, rect->x + rect->width - 1, 0x2191, 0);
+    if (view->scroll + visible < view->rows) {
+        fb_put(&r->fb, rect->y + visible, rect->x + rect->width - 1, 0x2193, 0);
+    }
+}
+
+static void render_minimap(AnsiRenderer *r, const Battlefield *bf) {
+    const Rect *rect = &bf->layout.minimap;
+    int level = minimap_level(bf);
+    fb_box(&r->fb, rect->y, rect->x, rect->height, rect->width, 0);
+    panel_print(r, rect, 0, 1, 0, " Map 1:%d ", 1 << level);
+
+    int rows = bf->density.height[level], cols = bf->density.width[level];
+    for (int my = 0; my < rows && my < rect->height - 2; my++) {
+        for (int mx = 0; mx < cols && mx < (rect->width - 2) / 2; mx++) {
+            MinimapPixel px;
+            minimap_pixel(bf, level, mx, my, &px);
+            int attrs = (px.shade > 0 ? FB_BOLD : px.shade < 0 ? FB_DIM : 0) |
+                        (px.in_view ? FB_REVERSE : 0);
+            panel_print(r, rect, 1 + my, 1 + mx * 2, FB_STYLE(px.color, attrs), "%c ", px.glyph);
+        }
+    }
+}
+
+static void render_hints(AnsiRenderer *r, const Battlefield *bf) {
+    const Rect *rect = &bf->layout.hints;
+    panel_frame(r, rect, " Hints ");
+    const char *hint = get_state_hint(bf->state);
+    int x = (rect->width - (int)strlen(hint)) / 2;
+    if (x < 2) x = 2;
+    panel_print(r, rect, 1, x, 0, "%s", hint);
+}
+
+static void render_messages(AnsiRenderer *r, const Battlefield *bf) {
+    const Rect *rect = &bf->layout.message;
+    fb_box(&r->fb, rect->y, rect->x, rect->height, rect->width, 0);
+    char message[256];
+    if (bf->log && combat_log_format(bf->log, 0, message, sizeof(message))) {
+        panel_print(r, rect, 1, 2, 0, "%s", message);
+    }
+    if (r->controls[0]) {
+        panel_print(r, rect, 2, 2, 0, "Controls: %s", r->controls);
+    }
+}
+
+void ansi_render_frame(Battlefield *bf) {
+    TRACE_SCOPE("ansi_render_frame");
+    AnsiRenderer *r = bf->ansi;
+    fb_clear(&r->fb);
+    render_grid(r, bf);
+    render_status(r, bf);
+    render_unit_list(r, bf);
+    render_minimap(r, bf);
+    render_hints(r, bf);
+    render_messages(r, bf);
+    if (r->banner[0]) {
+        // Same spot the ncurses loops use: the middle of the main window
+        int wy = bf->layout.message.y + bf->layout.message.height + 1;
+        int wx = bf->layout.message.width + 2;
+        fb_print(&r->fb, r->origin_y + wy / 2, r->origin_x + (wx - 12) / 2,
+                 FB_STYLE(r->banner_color, FB_BOLD), "%s", r->banner);
+    }
+    fb_present(&r->fb);
+}
+
+void ansi_show_banner(Battlefield *bf, int color, const char *text) {
+    snprintf(bf->ansi->banner, sizeof bf->ansi->banner, "%s", text);
+    bf->ansi->banner_color = color;
+    ansi_render_frame(bf);
+}
+
+bool enable_ansi_renderer(Battlefield *bf, int rows, int cols, RenderSink sink, void *sink_ctx) {
+    AnsiRenderer *r = calloc(1, sizeof *r);
+    if (!r) return false;
+    if (!fb_init(&r->fb, rows, cols, sink, sink_ctx)) {
+        free(r);
+        return false;
+    }
+    if (bf->main_win) getbegyx(bf->main_win, r->origin_y, r->origin_x);
+    bf->ansi = r;
+    return true;
+}
+
+// Swaps in a framebuffer of the new terminal size; the next frame is a full repaint
+bool ansi_resize(Battlefield *bf, int rows, int cols) {
+    AnsiRenderer *r = bf->ansi;
+    Framebuffer fb;
+    if (!fb_init(&fb, rows, cols, r->fb.sink, r->fb.sink_ctx)) return false;
+    fb_free(&r->fb);
+    r->fb = fb;
+    if (bf->main_win) getbegyx(bf->main_win, r->origin_y, r->origin_x);
+    return true;
+}
+
+void disable_ansi_renderer(Battlefield *bf) {
+    if (!bf->ansi) return;
+    fb_free(&bf->ansi->fb);
+    free(bf->ansi);
+    bf->ansi = NULL;
+    // Hand the screen back to ncurses in a known state
+    clearok(curscr, TRUE);
+}
@@ -0,0 +1,69 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "battlefield.h"
+
+// Cell attributes for the framebuffer renderer
+#define FB_BOLD    0x01
+#define FB_DIM     0x02
+#define FB_REVERSE 0x04
+
+// Packs a color pair (same numbering as init_pair in main.c) and FB_* attributes
+#define FB_STYLE(color, attrs) (((attrs) << 8) | (color))
+
+// Where finished frames go. The default sink is one write() to stdout.
+typedef void (*RenderSink)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    uint32_t glyph;     // Unicode code point
+    uint8_t color;      // Color pair, 0 = terminal default
+    uint8_t attrs;      // FB_BOLD | FB_DIM | FB_REVERSE
+} FbCell;
+
+// In-memory screen. Frames are drawn into `back`, diffed against `front`
+// (what the terminal shows) and only the changed cells are emitted.
+typedef struct {
+    int rows, cols;
+    FbCell *front;
+    FbCell *back;
+    bool valid;             // false forces a full repaint on the next present
+    char *out;              // Reused ANSI output buffer
+    size_t out_len, out_cap;
+    RenderSink sink;
+    void *sink_ctx;
+} Framebuffer;
+
+// Framebuffer-backed replacement for the ncurses panels of a Battlefield
+typedef struct AnsiRenderer {
+    Framebuffer fb;
+    int origin_y, origin_x;     // Screen position of the main window
+    const UNIT *selected;       // Unit shown in the status panel
+    char controls[128];         // Last controls hint
+    char banner[32];            // Centered end-of-game text, empty when hidden
+    int banner_color;
+} AnsiRenderer;
+
+// Framebuffer primitives
+bool fb_init(Framebuffer *fb, int rows, int cols, RenderSink sink, void *sink_ctx);
+void fb_free(Framebuffer *fb);
+void fb_clear(Framebuffer *fb);
+void fb_put(Framebuffer *fb, int y, int x, uint32_t glyph, int style);
+void fb_print(Framebuffer *fb, int y, int x, int style, const char *format, ...);
+void fb_hline(Framebuffer *fb, int y, int x, uint32_t glyph, int n, int style);
+void fb_vline(Framebuffer *fb, int y, int x, uint32_t glyph, int n, int style);
+void fb_box(Framebuffer *fb, int y, int x, int height, int width, int style);
+void fb_invalidate(Framebuffer *fb);
+size_t fb_present(Framebuffer *fb);
+void fb_stdout_sink(void *ctx, const char *data, size_t len);
+
+// Battlefield integration
+bool enable_ansi_renderer(Battlefield *bf, int rows, int cols, RenderSink sink, void *sink_ctx);
+void disable_ansi_renderer(Battlefield *bf);
+bool ansi_resize(Battlefield *bf, int rows, int cols);
+void ansi_render_frame(Battlefield *bf);
+void ansi_show_banner(Battlefield *bf, int color, const char *text);
+
+#endif // RENDER_H
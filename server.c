@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+// Per-client connection state, indexed by file descriptor
+typedef struct {
+    bool open;
+    uint16_t match_id;      // Subscribed match, 0 = none
+    int next_subscriber;    // Next fd watching the same match, -1 at the end
+    uint8_t team;           // Team the client plays (JOIN_*)
+    bool dropped;           // Fell behind or failed a write; closed after the current event
+    uint8_t in[PROTO_MAX_FRAME];
+    size_t in_len;
+    uint8_t *out;
+    size_t out_len, out_cap;
+} Connection;
+
+// Names in match messages are cut to this, so two of them fit in one
+#define MESSAGE_NAME 24
+
+static volatile sig_atomic_t server_running = 1;
+static int dropped_count;   // Connections marked dropped but not closed yet
+
+static void stop_server(int sig) {
+    (void)sig;
+    server_running = 0;
+}
+
+bool match_pool_init(MatchPool *pool, int capacity) {
+    pool->slots = calloc(capacity, sizeof(Match));
+    if (!pool->slots) return false;
+    pool->capacity = capacity;
+    pool->live = 0;
+    pool->free_list = NULL;
+    // Thread the free list backwards so low ids are handed out first
+    for (int i = capacity - 1; i >= 0; i--) {
+        pool->slots[i].id = (uint16_t)(i + 1);
+        pool->slots[i].next_free = pool->free_list;
+        pool->free_list = &pool->slots[i];
+    }
+    return true;
+}
+
+void match_pool_destroy(MatchPool *pool) {
+    free(pool->slots);
+    pool->slots = NULL;
+    pool->free_list = NULL;
+    pool->capacity = pool->live = 0;
+}
+
+Match *match_alloc(MatchPool *pool) {
+    Match *m = pool->free_list;
+    if (!m) return NULL;
+    pool->free_list = m->next_free;
+    pool->live++;
+
+    uint16_t id = m->id;
+    memset(m, 0, sizeof *m);
+    m->id = id;
+    m->in_use = true;
+    m->first_subscriber = -1;
+    return m;
+}
+
+void match_free(MatchPool *pool, Match *m) {
+    if (!m->in_use) return;
+    m->in_use = false;
+    m->next_free = pool->free_list;
+    pool->free_list = m;
+    pool->live--;
+}
+
+Match *match_lookup(MatchPool *pool, uint16_t id) {
+    if (id == 0 || id > pool->capacity) return NULL;
+    Match *m = &pool->slots[id - 1];
+    return m->in_use ? m : NULL;
+}
+
+void match_start(Match *m, const UNIT a1[], int n1, const UNIT a2[], int n2) {
+    init_battlefield(&m->bf);
+    memcpy(m->armies[0], a1, n1 * sizeof(UNIT));
+    memcpy(m->armies[1], a2, n2 * sizeof(UNIT));
+    m->counts[0] = n1;
+    m->counts[1] = n2;
+
+    // Same opening layout as the local game modes
+    for (int i = 0; i < n1; i++) {
+        place_unit(&m->bf, &m->armies[0][i], 1, 0, i * 2);
+    }
+    for (int i = 0; i < n2; i++) {
+        place_unit(&m->bf, &m->armies[1][i], 2, MAX_GRID_WIDTH - 1, i * 2);
+    }
+    m->turn = 1;
+    m->winner = 0;
+    snprintf(m->message, sizeof m->message, "Player 1's turn");
+}
+
+NetError match_apply_action(Match *m, int team, const NetAction *act) {
+    if (m->winner) return NET_ERR_INVALID_ACTION;
+    if (team != JOIN_BOTH && team != m->turn) return NET_ERR_NOT_YOUR_TURN;
+
+    Battlefield *bf = &m->bf;
+    int fx = act->from_x, fy = act->from_y, tx = act->to_x, ty = act->to_y;
+
+    if (act->kind != NET_ACT_END_TURN) {
+        if (!is_valid_position(fx, fy) || team_at(bf, fx, fy) != m->turn) {
+            return NET_ERR_INVALID_ACTION;
+        }
+    }
+
+    switch (act->kind) {
+        case NET_ACT_MOVE:
+            if (!move_unit(bf, fx, fy, tx, ty)) return NET_ERR_INVALID_ACTION;
+            snprintf(m->message, sizeof m->message, "%.*s moves to (%d,%d)",
+                     MESSAGE_NAME, unit_at(bf, tx, ty)->name, tx, ty);
+            break;
+
+        case NET_ACT_ATTACK:
+            {
+                UNIT *attacker = unit_at(bf, fx, fy);
+                if (!is_valid_attack_target(bf, attacker, fx, fy, tx, ty)) {
+                    return NET_ERR_INVALID_ACTION;
+                }
+                UNIT *target = unit_at(bf, tx, ty);
+                int target_team = team_at(bf, tx, ty);
+                int damage = calculate_damage(attacker, target);
+                damage_unit(bf, tx, ty, damage);   // Keeps the minimap hp sums in step
+                if (target->hp <= 0) {
+                    snprintf(m->message, sizeof m->message, "%.*s has been defeated!",
+                             MESSAGE_NAME, target->name);
+                    remove_unit(bf, tx, ty);
+                    m->counts[target_team - 1]--;
+                } else {
+                    snprintf(m->message, sizeof m->message, "%.*s hits %.*s for %d damage!",
+                             MESSAGE_NAME, attacker->name, MESSAGE_NAME, target->name, damage);
+                }
+            }
+            break;
+
+        case NET_ACT_END_TURN:
+            snprintf(m->message, sizeof m->message, "Player %d ends the turn", m->turn);
+            break;
+
+        default:
+            return NET_ERR_PROTOCOL;
+    }
+
+    if (m->counts[0] == 0) m->winner = 2;
+    else if (m->counts[1] == 0) m->winner = 1;
+    else m->turn = 3 - m->turn;
+    return NET_OK;
+}
+
+void match_snapshot(const Match *m, NetState *st) {
+    memset(st, 0, sizeof *st);
+    st->turn = (uint8_t)m->turn;
+    st->winner = (uint8_t)m->winner;
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < m->bf.unit_counts[t]; i++) {
+            const UnitSlot *slot = roster_slot(&m->bf, t, i);
+            const Position *pos = &slot->pos;
+            const UNIT *u = slot->unit;
+            NetUnit *nu = &st->units[st->count++];
+            nu->team = (uint8_t)(t + 1);
+            nu->x = (uint8_t)pos->x;
+            nu->y = (uint8_t)pos->y;
+            nu->hp = (uint8_t)(u->hp > 0 ? u->hp : 0);
+            int i1 = item_index(u->item1), i2 = item_index(u->item2);
+            nu->item1 = i1 < 0 ? PROTO_NO_ITEM : (uint8_t)i1;
+            nu->item2 = i2 < 0 ? PROTO_NO_ITEM : (uint8_t)i2;
+            snprintf(nu->name, sizeof nu->name, "%.*s", PROTO_NAME_MAX, u->name);
+        }
+    }
+    memcpy(st->message, m->message, sizeof st->message);
+}
+
+// ---------------------------------------------------------------------------
+// Connection handling
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void subscribe(Connection *conns, Match *m, int fd) {
+    conns[fd].match_id = m->id;
+    conns[fd].next_subscriber = m->first_subscriber;
+    m->first_subscriber = fd;
+    m->subscribers++;
+}
+
+static void unsubscribe(Connection *conns, MatchPool *pool, int fd) {
+    Match *m = match_lookup(pool, conns[fd].match_id);
+    conns[fd].match_id = 0;
+    if (!m) return;
+
+    // Subscriber lists are short (players plus spectators), a walk is fine
+    int *link = &m->first_subscriber;
+    while (*link != -1 && *link != fd) link = &conns[*link].next_subscriber;
+    if (*link == fd) *link = conns[fd].next_subscriber;
+
+    if (--m->subscribers <= 0) {
+        // Nobody is watching any more - give the slot back to the pool
+        match_free(pool, m);
+    }
+}
+
+static void close_connection(int epfd, Connection *conns, MatchPool *pool, int fd) {
+    Connection *c = &conns[fd];
+    if (!c->open) return;
+
+    unsubscribe(conns, pool, fd);
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    free(c->out);
+    memset(c, 0, sizeof *c);
+}
+
+static void watch_writable(int epfd, int fd, bool writable) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+// Marks a connection for closing. It can't be closed on the spot: a broadcast
+// may be walking the subscriber list it is on.
+static void drop_connection(Connection *c) {
+    if (c->dropped) return;
+    c->dropped = true;
+    dropped_count++;
+}
+
+static void close_dropped(int epfd, Connection *conns, MatchPool *pool, int max_fd) {
+    for (int fd = 0; fd <= max_fd; fd++) {
+        if (conns[fd].open && conns[fd].dropped) close_connection(epfd, conns, pool, fd);
+    }
+    dropped_count = 0;
+}
+
+// Try to push buffered output; returns false if the connection died
+static bool flush_connection(int epfd, Connection *c, int fd) {
+    size_t sent = 0;
+    while (sent < c->out_len) {
+        ssize_t n = send(fd, c->out + sent, c->out_len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    memmove(c->out, c->out + sent, c->out_len - sent);
+    c->out_len -= sent;
+    watch_writable(epfd, fd, c->out_len > 0);
+    return true;
+}
+
+// Buffers a frame for the client. One that has let SERVER_OUT_LIMIT pile up
+// is dropped rather than sent a stream with frames missing from it.
+static bool queue_frame(Connection *c, uint8_t type, uint16_t match_id,
+                        const uint8_t *payload, size_t len) {
+    if (c->dropped) return false;
+    size_t need = c->out_len + PROTO_HEADER_SIZE + len;
+    if (need > SERVER_OUT_LIMIT) {
+        drop_connection(c);
+        return false;
+    }
+    if (need > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap * 2 : 512;
+        while (cap < need) cap *= 2;
+        uint8_t *grown = realloc(c->out, cap);
+        if (!grown) {
+            drop_connection(c);
+            return false;
+        }
+        c->out = grown;
+        c->out_cap = cap;
+    }
+    c->out_len += proto_write_header(c->out + c->out_len, type, match_id, (uint16_t)len);
+    memcpy(c->out + c->out_len, payload, len);
+    c->out_len += len;
+    return true;
+}
+
+static void send_error(Connection *c, uint16_t match_id, NetError err) {
+    uint8_t code = (uint8_t)err;
+    queue_frame(c, MSG_ERROR, match_id, &code, 1);
+}
+
+static void send_state(Connection *c, const Match *m) {
+    NetState st;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    match_snapshot(m, &st);
+    size_t len = proto_encode_state(payload, sizeof payload, &st);
+    queue_frame(c, MSG_STATE, m->id, payload, len);
+}
+
+static void broadcast_state(int epfd, Connection *conns, const Match *m) {
+    // Encode once, then copy the frame to every subscriber
+    NetState st;
+    uint8_t payload[PROTO_MAX_PAYLOAD];
+    match_snapshot(m, &st);
+    size_t len = proto_encode_state(payload, sizeof payload, &st);
+
+    for (int fd = m->first_subscriber; fd != -1; fd = conns[fd].next_subscriber) {
+        Connection *c = &conns[fd];
+        if (queue_frame(c, MSG_STATE, m->id, payload, len) && !flush_connection(epfd, c, fd)) {
+            drop_connection(c);
+        }
+    }
+}
+
+// Handles one complete frame; returns false if the client should be dropped
+static bool handle_frame(int epfd, Connection *conns, MatchPool *pool,
+                         int fd, const MessageHeader *hdr, const uint8_t *payload) {
+    Connection *c = &conns[fd];
+
+    switch (hdr->type) {
+        case MSG_CREATE:
+            {
+                UNIT a1[MAX_ARMY], a2[MAX_ARMY];
+                int n1, n2;
+                if (!proto_decode_armies(payload, hdr->len, a1, &n1, a2, &n2)) {
+                    send_error(c, 0, NET_ERR_PROTOCOL);
+                    return true;
+                }
+                Match *m = match_alloc(pool);
+                if (!m) {
+                    send_error(c, 0, NET_ERR_POOL_FULL);
+                    return true;
+                }
+                match_start(m, a1, n1, a2, n2);
+                queue_frame(c, MSG_CREATED, m->id, NULL, 0);
+                // The creator holds the match open until it joins (or disconnects).
+                // It leaves any match it was watching, so every match has a subscriber.
+                unsubscribe(conns, pool, fd);
+                subscribe(conns, m, fd);
+                c->team = JOIN_SPECTATE;
+            }
+            return true;
+
+        case MSG_JOIN:
+            {
+                Match *m = match_lookup(pool, hdr->match_id);
+                if (!m || hdr->len != 1 || payload[0] > JOIN_BOTH) {
+                    send_error(c, hdr->match_id, m ? NET_ERR_PROTOCOL : NET_ERR_NO_MATCH);
+                    return true;
+                }
+                if (c->match_id != m->id) {
+                    unsubscribe(conns, pool, fd);
+                    subscribe(conns, m, fd);
+                }
+                c->team = payload[0];
+                send_state(c, m);
+            }
+            return true;
+
+        case MSG_ACTION:
+            {
+                Match *m = match_lookup(pool, hdr->match_id);
+                NetAction act;
+                if (!m || c->match_id != m->id) {
+                    send_error(c, hdr->match_id, NET_ERR_NO_MATCH);
+                    return true;
+                }
+                if (c->team == JOIN_SPECTATE || !proto_decode_action(payload, hdr->len, &act)) {
+                    send_error(c, m->id, NET_ERR_PROTOCOL);
+                    return true;
+                }
+                NetError err = match_apply_action(m, c->team, &act);
+                if (err != NET_OK) {
+                    send_error(c, m->id, err);
+                    return true;
+                }
+                broadcast_state(epfd, conns, m);
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool read_connection(int epfd, Connection *conns, MatchPool *pool, int fd) {
+    Connection *c = &conns[fd];
+
+    while (1) {
+        ssize_t n = recv(fd, c->in + c->in_len, sizeof c->in - c->in_len, 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        c->in_len += (size_t)n;
+
+        // Dispatch every complete frame sitting in the buffer
+        size_t off = 0;
+        MessageHeader hdr;
+        while (proto_read_header(c->in + off, c->in_len - off, &hdr)) {
+            if (hdr.len > PROTO_MAX_PAYLOAD) return false;
+            if (c->in_len - off < (size_t)PROTO_HEADER_SIZE + hdr.len) break;
+            if (!handle_frame(epfd, conns, pool, fd, &hdr,
+                              c->in + off + PROTO_HEADER_SIZE) || c->dropped) {
+                return false;
+            }
+            off += PROTO_HEADER_SIZE + hdr.len;
+        }
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+    }
+
+    return c->out_len == 0 || flush_connection(epfd, c, fd);
+}
+
+static int open_listener(const char *socket_path) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof addr.sun_path) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) < 0 ||
+        listen(fd, SOMAXCONN) < 0 ||
+        set_nonblocking(fd) < 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_match_server(const char *socket_path) {
+    MatchPool pool;
+    if (!match_pool_init(&pool, SERVER_MAX_MATCHES)) {
+        fprintf(stderr, "Could not allocate match pool\n");
+        return 1;
+    }
+    Connection *conns = calloc(SERVER_MAX_CLIENTS, sizeof(Connection));
+    int listen_fd = open_listener(socket_path);
+    int epfd = epoll_create1(0);
+    if (!conns || listen_fd < 0 || epfd < 0) {
+        free(conns);
+        match_pool_destroy(&pool);
+        if (listen_fd >= 0) close(listen_fd);
+        return 1;
+    }
+
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    printf("Match server listening on %s (%d match slots)\n", socket_path, pool.capacity);
+    fflush(stdout);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    int max_fd = listen_fd;
+
+    while (server_running) {
+        int n = epoll_wait(epfd, events, SERVER_MAX_EVENTS, 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listen_fd) {
+                // Accept everything that is pending
+                int cfd;
+                while ((cfd = accept(listen_fd, NULL, NULL)) >= 0) {
+                    if (cfd >= SERVER_MAX_CLIENTS || set_nonblocking(cfd) < 0) {
+                        close(cfd);
+                        continue;
+                    }
+                    memset(&conns[cfd], 0, sizeof conns[cfd]);
+                    conns[cfd].open = true;
+                    conns[cfd].next_subscriber = -1;
+                    ev.events = EPOLLIN;
+                    ev.data.fd = cfd;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &ev);
+                    if (cfd > max_fd) max_fd = cfd;
+                }
+                continue;
+            }
+
+            bool alive = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) alive = false;
+            if (alive && (events[i].events & EPOLLOUT)) {
+                alive = flush_connection(epfd, &conns[fd], fd);
+            }
+            if (alive && (events[i].events & EPOLLIN)) {
+                alive = read_connection(epfd, conns, &pool, fd);
+            }
+            if (!alive) close_connection(epfd, conns, &pool, fd);
+            if (dropped_count > 0) close_dropped(epfd, conns, &pool, max_fd);
+        }
+    }
+
+    for (int fd = 0; fd <= max_fd; fd++) {
+        close_connection(epfd, conns, &pool, fd);
+    }
+    close(epfd);
+    close(listen_fd);
+    unlink(socket_path);
+    free(conns);
+    match_pool_destroy(&pool);
+    printf("Match server stopped\n");
+    return 0;
+}
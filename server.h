@@ -0,0 +1,51 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include "battlefield.h"
+#include "protocol.h"
+
+// Match server limits
+#define SERVER_MAX_MATCHES 1024
+#define SERVER_MAX_CLIENTS 4096
+#define SERVER_MAX_EVENTS  256
+#define SERVER_OUT_LIMIT   (64 * 1024)  // Drop clients that stop reading
+
+// One hosted game. Matches live in a fixed pool and are recycled through a free list.
+typedef struct Match {
+    Battlefield bf;                 // Windows stay NULL; the server never draws
+    UNIT armies[2][MAX_ARMY];       // Units referenced by bf.cells
+    int counts[2];                  // Alive units per team
+    int turn;                       // Team to act next
+    int winner;                     // 0 while running
+    uint16_t id;                    // 1-based, 0 means "no match"
+    bool in_use;
+    int subscribers;                // Connected clients watching this match
+    int first_subscriber;           // Head of the subscriber list (fd), -1 if empty
+    char message[PROTO_MESSAGE_MAX + 1];
+    struct Match *next_free;
+} Match;
+
+typedef struct {
+    Match *slots;
+    Match *free_list;
+    int capacity;
+    int live;
+} MatchPool;
+
+// Match pool
+bool match_pool_init(MatchPool *pool, int capacity);
+void match_pool_destroy(MatchPool *pool);
+Match *match_alloc(MatchPool *pool);
+void match_free(MatchPool *pool, Match *m);
+Match *match_lookup(MatchPool *pool, uint16_t id);
+
+// Game rules applied on the server side (no ncurses involved)
+void match_start(Match *m, const UNIT a1[], int n1, const UNIT a2[], int n2);
+NetError match_apply_action(Match *m, int team, const NetAction *act);
+void match_snapshot(const Match *m, NetState *st);
+
+// Runs the epoll loop on a UNIX domain socket until SIGINT/SIGTERM
+int run_match_server(const char *socket_path);
+
+#endif // SERVER_H
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include "simul.h"
+#include "trace.h"
+#include "eventlog.h"
+
+// Closest enemy the team can see
+static bool closest_enemy(const Battlefield *bf, int team, int x, int y, Position *out) {
+    int enemy = team == 1 ? 1 : 0;
+    Bitboard sight = team_sight(bf, team);
+    int min_dist = MAX_GRID_WIDTH + MAX_GRID_HEIGHT;
+    bool found = false;
+    for (int i = 0; i < bf->unit_counts[enemy]; i++) {
+        Position pos = roster_slot(bf, enemy, i)->pos;
+        if (!(sight & cell_bit(pos.x, pos.y))) continue;
+        int dist = manhattan_distance(x, y, pos.x, pos.y);
+        if (dist < min_dist) {
+            min_dist = dist;
+            *out = pos;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// When both straight steps are blocked, the reachable cell that gets closest
+// to the target, if any gets closer than where the unit stands
+static bool closest_reachable(const Battlefield *bf, int x, int y, Position target, Position *out) {
+    Bitboard cells = move_targets(bf, x, y);
+    int best = manhattan_distance(x, y, target.x, target.y);
+    bool found = false;
+    while (cells) {
+        int cell = bb_pop(&cells);
+        int cx = cell % MAX_GRID_WIDTH, cy = cell / MAX_GRID_WIDTH;
+        int dist = manhattan_distance(cx, cy, target.x, target.y);
+        if (dist < best) {
+            best = dist;
+            *out = (Position){cx, cy};
+            found = true;
+        }
+    }
+    return found;
+}
+
+void choose_intent(const Battlefield *bf, UnitHandle actor, Intent *out) {
+    TRACE_SCOPE("choose_intent");
+    const UnitSlot *slot = unit_slot(bf, actor);
+    *out = (Intent){INTENT_WAIT, actor, {-1, -1}, {-1, -1}};
+    if (!slot || has_effect(bf, HANDLE_SLOT(actor), EFFECT_FREEZE)) return;
+
+    int x = slot->pos.x, y = slot->pos.y;
+    out->from = slot->pos;
+
+    // A special is worth it when it catches more than one enemy
+    if (count_blast_targets(bf, slot->unit, x, y) >= 2) {
+        out->type = INTENT_SPECIAL;
+        return;
+    }
+    if (closest_attack_target(bf, slot->unit, x, y, &out->to)) {
+        out->type = INTENT_ATTACK;
+        return;
+    }
+
+    // Otherwise step towards the closest enemy, sideways first, or around
+    // whatever is in the way. With no enemy in sight, scout across the board
+    // towards the enemy's home column.
+    Position target;
+    if (!closest_enemy(bf, slot->team, x, y, &target)) {
+        if (bf->unit_counts[slot->team == 1 ? 1 : 0] == 0) return;
+        target = (Position){slot->team == 1 ? MAX_GRID_WIDTH - 1 : 0, y};
+    }
+    int dx = (target.x > x) - (target.x < x);
+    int dy = (target.y > y) - (target.y < y);
+    if (dx != 0 && is_valid_move(bf, x, y, x + dx, y)) {
+        out->to = (Position){x + dx, y};
+    } else if (dy != 0 && is_valid_move(bf, x, y, x, y + dy)) {
+        out->to = (Position){x, y + dy};
+    } else if (!closest_reachable(bf, x, y, target, &out->to)) {
+        return;
+    }
+    out->type = INTENT_MOVE;
+}
+
+// Fills intents[] (indexed by slot) for every unit on the board. Each
+// intent only reads the board, so the order units are planned in doesn't
+// matter.
+void plan_round(const Battlefield *bf, Intent intents[UNIT_SLOTS]) {
+    TRACE_SCOPE("plan_round");
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        const UnitSlot *slot = &bf->slots[s];
+        UnitHandle h = slot->unit ? bf->cells[slot->pos.y][slot->pos.x].handle : NO_UNIT;
+        choose_intent(bf, h, &intents[s]);
+    }
+}
+
+// Applies a planned round. Everything happens against the board the intents
+// were planned on, in slot order, so no unit's move depends on another's
+// having gone first:
+//   1. Units that wait brace, then every attack and blast lands, including
+//      those of units that fall this round, and damage is summed per target.
+//   2. Units at 0 hp or below are removed; survivors of a blast take on its
+//      item's effect.
+//   3. Survivors step into the cells they chose, all of which were empty when
+//      planned. When two units want the same cell, the team with the
+//      initiative wins, then the lower slot; the loser stays put.
+void resolve_round(Battlefield *bf, const Intent intents[UNIT_SLOTS], int initiative,
+                   int remaining[2], RoundSummary *summary) {
+    TRACE_SCOPE("resolve_round");
+    int damage[UNIT_SLOTS] = {0};
+    const ITEM *blasted[UNIT_SLOTS] = {0};
+    memset(summary, 0, sizeof(*summary));
+
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        const UnitSlot *slot = unit_slot(bf, intents[s].actor);
+        if (slot && intents[s].type == INTENT_WAIT) brace_unit(bf, (int)(slot - bf->slots));
+    }
+
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        const Intent *intent = &intents[s];
+        const UnitSlot *slot = unit_slot(bf, intent->actor);
+        if (!slot) continue;
+
+        Bitboard hit = 0;
+        if (intent->type == INTENT_ATTACK) {
+            hit = enemy_cells(bf, slot->team) & cell_bit(intent->to.x, intent->to.y);
+        } else if (intent->type == INTENT_SPECIAL) {
+            hit = blast_targets(bf, slot->unit, slot->pos.x, slot->pos.y);
+        }
+        if (hit) summary->attacks++;
+
+        while (hit) {
+            int cell = bb_pop(&hit);
+            int tx = cell % MAX_GRID_WIDTH, ty = cell / MAX_GRID_WIDTH;
+            UnitHandle target = bf->cells[ty][tx].handle;
+            int t = HANDLE_SLOT(target);
+            const UNIT *victim = bf->slots[t].unit;
+            int dealt = attack_damage(bf, slot->unit, tx, ty);
+            // Damage lands later, so the kill goes to the hit that takes
+            // the running total past the target's hp
+            bool kill = damage[t] < victim->hp && damage[t] + dealt >= victim->hp;
+            damage[t] += dealt;
+            if (intent->type == INTENT_SPECIAL) blasted[t] = special_item(slot->unit);
+            summary->damage += dealt;
+            eventlog_hit(slot->unit, victim, dealt, manhattan_distance(slot->pos.x, slot->pos.y, tx, ty),
+                         bf->round, kill);
+        }
+    }
+
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        UnitSlot *slot = &bf->slots[s];
+        if (!slot->unit || damage[s] == 0) continue;
+
+        damage_unit(bf, slot->pos.x, slot->pos.y, damage[s]);
+        if (slot->unit->hp <= 0) {
+            int t = slot->team - 1;
+            remove_unit(bf, slot->pos.x, slot->pos.y);
+            remaining[t]--;
+            summary->defeated[t]++;
+        } else {
+            apply_effect(bf, s, blasted[s]);
+        }
+    }
+
+    int claim[BOARD_CELLS];
+    for (int c = 0; c < BOARD_CELLS; c++) claim[c] = -1;
+    for (int s = 0; s < UNIT_SLOTS; s++) {
+        const Intent *intent = &intents[s];
+        if (intent->type != INTENT_MOVE || !unit_slot(bf, intent->actor)) continue;
+
+        int cell = intent->to.y * MAX_GRID_WIDTH + intent->to.x;
+        int other = claim[cell];
+        if (other < 0) {
+            claim[cell] = s;
+            continue;
+        }
+        summary->blocked++;
+        if (bf->slots[s].team == initiative && bf->slots[other].team != initiative) {
+            claim[cell] = s;
+        }
+    }
+    for (int c = 0; c < BOARD_CELLS; c++) {
+        if (claim[c] < 0) continue;
+        const Intent *intent = &intents[claim[c]];
+        if (move_unit(bf, intent->from.x, intent->from.y, intent->to.x, intent->to.y)) {
+            summary->moves++;
+        }
+    }
+}
+
+// Effects move on a tick and burns can finish units off
+void end_phase(Battlefield *bf, int remaining[2], EffectReport *report) {
+    effects_tick(bf, report);
+    remaining[0] -= report->defeated[0];
+    remaining[1] -= report->defeated[1];
+}
+
+void end_turn(Battlefield *bf, int slot, int remaining[2], EffectReport *report) {
+    uint32_t from = bf->initiative.ready[slot];
+    memset(report, 0, sizeof(*report));
+    initiative_act(bf, slot);
+
+    // One effect tick for every tick boundary before the next unit's turn;
+    // re-check the queue after each, burns may have taken the next unit
+    for (;;) {
+        int next = initiative_next(bf);
+        if (next < 0 || remaining[0] <= 0 || remaining[1] <= 0) break;
+        if (bf->initiative.ready[next] / EFFECT_TICK_TIME <= from / EFFECT_TICK_TIME) break;
+        from = (from / EFFECT_TICK_TIME + 1) * EFFECT_TICK_TIME;
+
+        EffectReport tick;
+        end_phase(bf, remaining, &tick);
+        report->burns += tick.burns;
+        report->damage += tick.damage;
+        report->defeated[0] += tick.defeated[0];
+        report->defeated[1] += tick.defeated[1];
+    }
+}
+
+// Same rules as the animated battle in main.c: units act one at a time in
+// initiative order until the round's time is up. A lone intent resolves
+// exactly like its animated counterpart.
+static void play_sequential_round(Battlefield *bf, int round, int remaining[2]) {
+    Intent intents[UNIT_SLOTS];
+    for (int s = 0; s < UNIT_SLOTS; s++) intents[s] = (Intent){INTENT_WAIT, NO_UNIT, {-1, -1}, {-1, -1}};
+
+    uint32_t round_end = (uint32_t)round * ROUND_TIME;
+    int slot;
+    while (remaining[0] > 0 && remaining[1] > 0 &&
+           (slot = initiative_next(bf)) >= 0 && bf->initiative.ready[slot] < round_end) {
+        UnitHandle actor = slot_handle(bf, slot);
+        Intent *intent = &intents[slot];
+        RoundSummary summary;
+        EffectReport report;
+        choose_intent(bf, actor, intent);
+        resolve_round(bf, intents, bf->slots[slot].team, remaining, &summary);
+        intent->type = INTENT_WAIT;
+        intent->actor = NO_UNIT;
+        end_turn(bf, slot, remaining, &report);
+    }
+}
+
+int play_headless(Battlefield *bf, int max_rounds, bool simultaneous, int *rounds_played) {
+    int remaining[2] = {bf->unit_counts[0], bf->unit_counts[1]};
+    int round = 0;
+    while (remaining[0] > 0 && remaining[1] > 0 && round < max_rounds) {
+        round++;
+        bf->round = round;
+        if (simultaneous) {
+            Intent intents[UNIT_SLOTS];
+            RoundSummary summary;
+            EffectReport report;
+            plan_round(bf, intents);
+            resolve_round(bf, intents, round % 2 + 1, remaining, &summary);
+            for (int t = 0; t < TICKS_PER_ROUND; t++) end_phase(bf, remaining, &report);
+        } else {
+            play_sequential_round(bf, round, remaining);
+        }
+    }
+    if (rounds_played) *rounds_played = round;
+    if (remaining[0] > 0 && remaining[1] <= 0) return 1;
+    if (remaining[1] > 0 && remaining[0] <= 0) return 2;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SIMUL_H
+#define SIMUL_H
+
+#include <stdbool.h>
+#include "battlefield.h"
+
+// What an AI unit wants to do this round
+typedef enum {
+    INTENT_WAIT,
+    INTENT_MOVE,
+    INTENT_ATTACK,
+    INTENT_SPECIAL
+} IntentType;
+
+typedef struct {
+    IntentType type;
+    UnitHandle actor;
+    Position from;
+    Position to;            // Step destination or attack target, unused otherwise
+} Intent;
+
+// Outcome of one simultaneous round
+typedef struct {
+    int attacks;            // Attacks and blasts that landed
+    int damage;             // Total damage dealt
+    int defeated[2];        // Units each team lost
+    int moves;
+    int blocked;            // Moves lost to another unit claiming the same cell
+} RoundSummary;
+
+// AI decision for one unit. Only reads the board, so any number of units can
+// be planned at once against the same snapshot.
+void choose_intent(const Battlefield *bf, UnitHandle actor, Intent *out);
+
+void plan_round(const Battlefield *bf, Intent intents[UNIT_SLOTS]);
+void resolve_round(Battlefield *bf, const Intent intents[UNIT_SLOTS], int initiative,
+                   int remaining[2], RoundSummary *summary);
+
+// Advances status effects one tick, taking units lost to burns off
+// remaining[]. A round is TICKS_PER_ROUND ticks.
+void end_phase(Battlefield *bf, int remaining[2], EffectReport *report);
+
+// Ends the turn of the unit in `slot`, which must be next in initiative
+// order: it goes back in the queue one delay later, and effects tick for the
+// time that passes before the next unit's turn.
+void end_turn(Battlefield *bf, int slot, int remaining[2], EffectReport *report);
+
+// Plays the armies already placed on bf to the end without drawing anything.
+// Returns the winning team, or 0 for a draw after max_rounds.
+int play_headless(Battlefield *bf, int max_rounds, bool simultaneous, int *rounds_played);
+
+#endif // SIMUL_H
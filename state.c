@@ -0,0 +1,88 @@
+#include <string.h>
+#include "state.h"
+
+static uint8_t item_id(const ITEM *item) {
+    int idx = item_index(item);
+    return idx < 0 ? STATE_NO_ITEM : (uint8_t)idx;
+}
+
+static const ITEM *item_of(uint8_t id) {
+    return id < NUMBER_OF_ITEMS ? &items[id] : NULL;
+}
+
+void state_capture(BattleState *st, const Battlefield *bf,
+                   const UNIT *const armies[2], const int sizes[2], int turn) {
+    memset(st, 0, sizeof(*st));
+    memset(st->cells, STATE_NO_UNIT, sizeof(st->cells));
+    st->turn = (uint8_t)turn;
+
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < sizes[t]; i++) {
+            const UNIT *unit = &armies[t][i];
+            st->units[t * MAX_ARMY + i] = (UnitRecord){
+                (uint8_t)(t + 1), -1, -1,
+                {item_id(unit->item1), item_id(unit->item2)}, (int16_t)unit->hp, {{{0}}}, 0
+            };
+        }
+    }
+
+    for (int t = 0; t < 2; t++) {
+        for (int r = 0; r < bf->unit_counts[t]; r++) {
+            const UnitSlot *slot = roster_slot(bf, t, r);
+            int i = 0;
+            while (i < sizes[t] && &armies[t][i] != slot->unit) i++;
+            if (i == sizes[t]) continue;
+
+            int u = t * MAX_ARMY + i;
+            st->units[u].x = (int8_t)slot->pos.x;
+            st->units[u].y = (int8_t)slot->pos.y;
+            st->cells[slot->pos.y * MAX_GRID_WIDTH + slot->pos.x] = (uint8_t)u;
+            get_unit_effects(bf, (int)(slot - bf->slots), &st->units[u].effects);
+            st->units[u].ready = bf->initiative.ready[slot - bf->slots];
+        }
+    }
+}
+
+bool state_valid(const BattleState *st) {
+    if (st->turn != 1 && st->turn != 2) return false;
+
+    for (int u = 0; u < UNIT_SLOTS; u++) {
+        const UnitRecord *rec = &st->units[u];
+        if (rec->team == 0) continue;
+        if (rec->team != u / MAX_ARMY + 1) return false;
+        for (int k = 0; k < 2; k++) {
+            if (rec->items[k] != STATE_NO_ITEM && rec->items[k] >= NUMBER_OF_ITEMS) return false;
+        }
+        if (rec->x < 0) continue;
+        if (!is_valid_position(rec->x, rec->y) || rec->hp <= 0) return false;
+        if (state_unit_at(st, rec->x, rec->y) != u) return false;
+    }
+
+    for (int cell = 0; cell < BOARD_CELLS; cell++) {
+        int u = st->cells[cell];
+        if (u == STATE_NO_UNIT) continue;
+        if (u >= UNIT_SLOTS || st->units[u].team == 0 || st->units[u].x < 0) return false;
+        if (st->units[u].y * MAX_GRID_WIDTH + st->units[u].x != cell) return false;
+    }
+    return true;
+}
+
+void state_restore(Battlefield *bf, const BattleState *st, UNIT *const armies[2], int alive[2]) {
+    clear_units(bf);
+    alive[0] = alive[1] = 0;
+    for (int u = 0; u < UNIT_SLOTS; u++) {
+        const UnitRecord *rec = &st->units[u];
+        if (rec->team == 0) continue;
+
+        UNIT *unit = &armies[rec->team - 1][u % MAX_ARMY];
+        unit->hp = rec->hp;
+        unit->item1 = item_of(rec->items[0]);
+        unit->item2 = item_of(rec->items[1]);
+        if (rec->x < 0) continue;
+        UnitHandle handle = place_unit(bf, unit, rec->team, rec->x, rec->y);
+        if (handle == NO_UNIT) continue;
+        set_unit_effects(bf, HANDLE_SLOT(handle), &rec->effects);
+        initiative_set(bf, HANDLE_SLOT(handle), rec->ready);
+        alive[rec->team - 1]++;
+    }
+}
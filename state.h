@@ -0,0 +1,49 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "battlefield.h"
+
+#define STATE_NO_UNIT 0xFF
+#define STATE_NO_ITEM 0xFF
+
+// Units are referred to by index: army 1's units from 0, army 2's from
+// MAX_ARMY, in army order. Names stay with the armies; everything a turn
+// can change is in the record.
+typedef struct {
+    uint8_t team;               // 1 or 2, 0 for an index no unit uses
+    int8_t x, y;                // x < 0 once the unit has left the board
+    uint8_t items[2];           // Catalog ids, STATE_NO_ITEM for an empty hand
+    int16_t hp;
+    UnitEffects effects;        // Running effects, in ticks from the saved moment
+    uint32_t ready;             // Initiative time of the unit's next turn
+} UnitRecord;
+
+// A battle with no pointers in it, a couple of hundred bytes. Clone it with
+// a plain assignment, hand it to another thread or write it out as-is.
+typedef struct {
+    uint8_t cells[BOARD_CELLS]; // Unit index on each cell, STATE_NO_UNIT when empty
+    UnitRecord units[UNIT_SLOTS];
+    uint8_t turn;               // Team to act next
+} BattleState;
+
+static inline int state_unit_at(const BattleState *st, int x, int y) {
+    int u = st->cells[y * MAX_GRID_WIDTH + x];
+    return u == STATE_NO_UNIT ? -1 : u;
+}
+
+// Records the board and the first sizes[t] units of each army, including
+// those that have already fallen. Units on the board must come from armies[].
+void state_capture(BattleState *st, const Battlefield *bf,
+                   const UNIT *const armies[2], const int sizes[2], int turn);
+
+// Whether a state read from outside holds together: every unit in a valid
+// cell that points back at it, items from the catalog and a team to move
+bool state_valid(const BattleState *st);
+
+// Puts the state back on the board. Units take their hp and items from the
+// state and keep their names; alive[] gets the units left on each side.
+void state_restore(Battlefield *bf, const BattleState *st, UNIT *const armies[2], int alive[2]);
+
+#endif // STATE_H
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <string.h>
+#include "terrain.h"
+
+const TerrainInfo terrain_info[TERRAIN_COUNT] = {
+    {'.', "plain",  1, false, 0},
+    {'f', "forest", 2, false, 4},
+    {'~', "water",  0, false, 5},
+    {'#', "wall",   0, true,  6},
+};
+
+static int terrain_for_glyph(char c) {
+    for (int t = 0; t < TERRAIN_COUNT; t++) {
+        if (terrain_info[t].glyph == c) return t;
+    }
+    return -1;
+}
+
+int load_terrain(const char *path, uint8_t *cells, int width, int height, char *err, size_t err_len) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        snprintf(err, err_len, "%s: cannot open", path);
+        return -1;
+    }
+
+    char line[256];
+    int lineno = 0, row = 0;
+    const char *problem = NULL;
+    while (!problem && fgets(line, sizeof(line), f)) {
+        lineno++;
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len == 0 || line[0] == ';') continue;
+
+        if (row == height) {
+            problem = "more rows than the board";
+        } else if ((int)len != width) {
+            problem = "row is not as wide as the board";
+        }
+        for (int x = 0; !problem && x < width; x++) {
+            int t = terrain_for_glyph(line[x]);
+            if (t < 0) {
+                problem = "unknown terrain (use . f ~ #)";
+            } else if ((x == 0 || x == width - 1) && terrain_info[t].move_cost == 0) {
+                problem = "the deployment columns must be passable";
+            } else {
+                cells[row * width + x] = (uint8_t)t;
+            }
+        }
+        row++;
+    }
+    fclose(f);
+
+    if (!problem && row < height) {
+        lineno++;
+        problem = "fewer rows than the board";
+    }
+    if (problem) {
+        snprintf(err, err_len, "%s:%d: %s", path, lineno, problem);
+        return -1;
+    }
+    return 0;
+}
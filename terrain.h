@@ -0,0 +1,39 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    TERRAIN_PLAIN,
+    TERRAIN_FOREST,
+    TERRAIN_WATER,
+    TERRAIN_WALL,
+    TERRAIN_COUNT
+} Terrain;
+
+typedef struct {
+    char glyph;             // Symbol in map files and on the board
+    const char *name;
+    int move_cost;          // Movement points to enter, 0 = impassable
+    bool blocks_sight;
+    int color;              // Color pair, same numbering as init_pair in main.c
+} TerrainInfo;
+
+extern const TerrainInfo terrain_info[TERRAIN_COUNT];
+
+// Map files hold one line of glyphs per board row, top row first:
+//
+//     ; Comments and blank lines are skipped
+//     ..........
+//     ...##.....
+//     ..ff~~ff..
+//
+// '.' plain, 'f' forest, '~' water, '#' wall. The first and last columns are
+// where the armies deploy, so they may only hold plain and forest.
+// Fills cells (row-major, width * height) and returns 0; on failure err holds
+// "file:line: reason" and -1 is returned.
+int load_terrain(const char *path, uint8_t *cells, int width, int height, char *err, size_t err_len);
+
+#endif // TERRAIN_H
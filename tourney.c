@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "army.h"
+#include "simul.h"
+#include "tourney.h"
+#include "trace.h"
+
+#define RESULT_PENDING (-1)
+
+// Bounded queue of game numbers between the scheduler and the workers
+typedef struct {
+    int jobs[TOURNEY_QUEUE_SIZE];
+    int head, count;
+    bool closed;                // No more games will be queued
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} WorkQueue;
+
+typedef struct {
+    const TournamentOptions *opts;
+    const Roster *roster;
+    int (*pairs)[2];            // Army indices of every pairing
+    int pair_count;
+    int total;                  // pair_count * games
+    uint64_t seed;              // Tournament fingerprint, also seeds deployments
+    signed char *results;       // Per game: winning side 0 (first army), 1, 2 for a draw
+    int done;
+    FILE *journal;
+    pthread_mutex_t lock;       // Guards results, done and the journal
+    WorkQueue queue;
+} Tournament;
+
+static void queue_push(WorkQueue *q, int job) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == TOURNEY_QUEUE_SIZE) pthread_cond_wait(&q->not_full, &q->lock);
+    q->jobs[(q->head + q->count++) % TOURNEY_QUEUE_SIZE] = job;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void queue_close(WorkQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Next game to play, or -1 once the queue is closed and drained
+static int queue_pop(WorkQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->not_empty, &q->lock);
+    int job = -1;
+    if (q->count > 0) {
+        job = q->jobs[q->head];
+        q->head = (q->head + 1) % TOURNEY_QUEUE_SIZE;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t splitmix(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Identifies a tournament by its roster file and settings, so a journal is
+// never resumed against a different roster
+static bool fingerprint(const TournamentOptions *opts, uint64_t *out) {
+    FILE *f = fopen(opts->roster_path, "rb");
+    if (!f) return false;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, f)) > 0) h = fnv1a(h, buf, n);
+    fclose(f);
+    h = fnv1a(h, &opts->games, sizeof opts->games);
+    h = fnv1a(h, &opts->simultaneous, sizeof opts->simultaneous);
+    if (opts->fog) h = fnv1a(h, &opts->fog, sizeof opts->fog);   // Older journals stay valid
+    *out = h;
+    return true;
+}
+
+// Game number job is game (job / pair_count) of pairing (job % pair_count), so
+// every pair plays its first game before any pair plays its second. Sides
+// alternate between games and each game deploys both armies on random rows
+// of their home columns, seeded by the game number.
+static int play_game(const Tournament *t, int job, int *rounds) {
+    const int *pair = t->pairs[job % t->pair_count];
+    int game = job / t->pair_count;
+    int first = game % 2;       // Which army of the pair plays team 1
+    UNIT units[2][MAX_ARMY];
+    Battlefield bf;
+    init_battlefield(&bf);
+
+    uint64_t rng = t->seed ^ ((uint64_t)job * 0x2545f4914f6cdd1dULL);
+    for (int side = 0; side < 2; side++) {
+        const Army *army = &t->roster->armies[pair[side ^ first]];
+        int rows[MAX_GRID_HEIGHT];
+        for (int r = 0; r < MAX_GRID_HEIGHT; r++) rows[r] = r;
+        for (int r = MAX_GRID_HEIGHT - 1; r > 0; r--) {
+            int k = (int)(splitmix(&rng) % (uint64_t)(r + 1));
+            int tmp = rows[r];
+            rows[r] = rows[k];
+            rows[k] = tmp;
+        }
+        for (int i = 0; i < army->count; i++) {
+            units[side][i] = army->units[i];
+            place_unit(&bf, &units[side][i], side + 1, side ? MAX_GRID_WIDTH - 1 : 0, rows[i]);
+        }
+    }
+
+    fog_enable(&bf, t->opts->fog);
+    int winner = play_headless(&bf, TOURNEY_MAX_ROUNDS, t->opts->simultaneous, rounds);
+    if (winner == 0) return 2;
+    return (winner - 1) ^ first;
+}
+
+// Plays one game and journals it before anything else can be lost
+static void finish_game(Tournament *t, int job) {
+    TRACE_SCOPE("tournament_game");
+    int rounds;
+    int result = play_game(t, job, &rounds);
+
+    pthread_mutex_lock(&t->lock);
+    t->results[job] = (signed char)result;
+    fprintf(t->journal, "%d %d %d\n", job, result, rounds);
+    fflush(t->journal);
+    t->done++;
+    fprintf(stderr, "\rPlayed %d/%d games", t->done, t->total);
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void *tournament_worker(void *arg) {
+    Tournament *t = arg;
+    int job;
+    trace_thread_name("tournament");
+    while ((job = queue_pop(&t->queue)) >= 0) finish_game(t, job);
+    return NULL;
+}
+
+// Loads finished games from an existing journal and drops a torn last line.
+// Returns false if the journal belongs to a different tournament.
+static bool read_journal(Tournament *t, const char *path) {
+    FILE *f = fopen(path, "r+");
+    if (!f) return true;
+
+    char line[128];
+    bool ok = false;
+    unsigned long long seed;
+    if (!fgets(line, sizeof line, f)) {
+        fclose(f);
+        return true;    // Empty: nothing was played yet
+    }
+    if (sscanf(line, "battle_arena tournament %llx", &seed) == 1) ok = seed == t->seed;
+
+    long good_end = ftell(f);
+    while (ok && fgets(line, sizeof line, f)) {
+        int job, result, rounds;
+        if (!strchr(line, '\n') || sscanf(line, "%d %d %d", &job, &result, &rounds) != 3 ||
+            job < 0 || job >= t->total || result < 0 || result > 2) {
+            break;
+        }
+        if (t->results[job] == RESULT_PENDING) t->done++;
+        t->results[job] = (signed char)result;
+        good_end = ftell(f);
+    }
+    if (ok && ftruncate(fileno(f), good_end) != 0) ok = false;
+    fclose(f);
+    return ok;
+}
+
+typedef struct {
+    int army;
+    double elo;
+    int wins, draws, losses;
+} Standing;
+
+static int by_elo(const void *a, const void *b) {
+    const Standing *x = a, *y = b;
+    if (x->elo != y->elo) return x->elo < y->elo ? 1 : -1;
+    return x->army - y->army;
+}
+
+// Elo over the games in game-number order, so the ratings never depend on
+// which worker finished first
+static void rate(const Tournament *t, Standing *table) {
+    int n = t->roster->count;
+    for (int i = 0; i < n; i++) table[i] = (Standing){i, TOURNEY_ELO_START, 0, 0, 0};
+
+    for (int job = 0; job < t->total; job++) {
+        if (t->results[job] == RESULT_PENDING) continue;
+        Standing *a = &table[t->pairs[job % t->pair_count][0]];
+        Standing *b = &table[t->pairs[job % t->pair_count][1]];
+        double score = t->results[job] == 0 ? 1.0 : t->results[job] == 1 ? 0.0 : 0.5;
+        double expected = 1.0 / (1.0 + pow(10.0, (b->elo - a->elo) / 400.0));
+        double delta = TOURNEY_ELO_K * (score - expected);
+        a->elo += delta;
+        b->elo -= delta;
+
+        if (t->results[job] == 0) { a->wins++; b->losses++; }
+        else if (t->results[job] == 1) { b->wins++; a->losses++; }
+        else { a->draws++; b->draws++; }
+    }
+    qsort(table, n, sizeof *table, by_elo);
+}
+
+static void write_table(FILE *out, const Tournament *t, const Standing *table) {
+    fprintf(out, "Tournament: %s, %d armies, %d games per pair, %d/%d games played%s%s\n\n",
+            t->opts->roster_path, t->roster->count, t->opts->games, t->done, t->total,
+            t->opts->simultaneous ? ", simultaneous rounds" : "",
+            t->opts->fog ? ", fog of war" : "");
+    fprintf(out, "%4s  %-24s %6s %6s %5s %5s %5s %7s\n",
+            "Rank", "Army", "Elo", "Games", "W", "D", "L", "Score");
+    for (int i = 0; i < t->roster->count; i++) {
+        const Standing *s = &table[i];
+        int games = s->wins + s->draws + s->losses;
+        double score = games ? 100.0 * (s->wins + 0.5 * s->draws) / games : 0.0;
+        fprintf(out, "%4d  %-24.24s %6.0f %6d %5d %5d %5d %6.1f%%\n",
+                i + 1, t->roster->armies[s->army].name, s->elo, games,
+                s->wins, s->draws, s->losses, score);
+    }
+}
+
+int run_tournament(const TournamentOptions *opts) {
+    Roster roster = {0};
+    char err[256];
+    if (load_roster(opts->roster_path, &roster, err, sizeof err) != 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    if (roster.count < 2 || opts->games < 1) {
+        fprintf(stderr, "A tournament needs at least two armies and one game per pair\n");
+        free_roster(&roster);
+        return 1;
+    }
+
+    Tournament t = {0};
+    t.opts = opts;
+    t.roster = &roster;
+    t.pair_count = roster.count * (roster.count - 1) / 2;
+    t.total = t.pair_count * opts->games;
+    t.pairs = malloc(t.pair_count * sizeof *t.pairs);
+    t.results = malloc(t.total);
+    if (!t.pairs || !t.results || !fingerprint(opts, &t.seed)) {
+        fprintf(stderr, "Could not set up the tournament\n");
+        free(t.pairs); free(t.results);
+        free_roster(&roster);
+        return 1;
+    }
+    memset(t.results, RESULT_PENDING, t.total);
+    for (int i = 0, p = 0; i < roster.count; i++) {
+        for (int j = i + 1; j < roster.count; j++, p++) {
+            t.pairs[p][0] = i;
+            t.pairs[p][1] = j;
+        }
+    }
+
+    char journal_path[1024];
+    snprintf(journal_path, sizeof journal_path, "%s.journal", opts->results_path);
+    if (!read_journal(&t, journal_path)) {
+        fprintf(stderr, "%s belongs to a different roster or settings; remove it to start over\n",
+                journal_path);
+        free(t.pairs); free(t.results);
+        free_roster(&roster);
+        return 1;
+    }
+    t.journal = fopen(journal_path, "a");
+    if (!t.journal) {
+        fprintf(stderr, "Could not open %s\n", journal_path);
+        free(t.pairs); free(t.results);
+        free_roster(&roster);
+        return 1;
+    }
+    fseek(t.journal, 0, SEEK_END);
+    if (ftell(t.journal) == 0) {
+        fprintf(t.journal, "battle_arena tournament %016llx\n", (unsigned long long)t.seed);
+        fflush(t.journal);
+    }
+
+    int jobs = opts->jobs;
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1) jobs = 1;
+    printf("%d armies, %d pairings, %d games (%d already played), %d workers\n",
+           roster.count, t.pair_count, t.total, t.done, jobs);
+
+    pthread_mutex_init(&t.lock, NULL);
+    pthread_mutex_init(&t.queue.lock, NULL);
+    pthread_cond_init(&t.queue.not_empty, NULL);
+    pthread_cond_init(&t.queue.not_full, NULL);
+
+    pthread_t *workers = malloc(jobs * sizeof *workers);
+    int started = 0;
+    while (workers && started < jobs &&
+           pthread_create(&workers[started], NULL, tournament_worker, &t) == 0) {
+        started++;
+    }
+    // Workers only write the entries of games already queued, so the
+    // entries checked here are never written concurrently
+    for (int job = 0; job < t.total; job++) {
+        if (t.results[job] != RESULT_PENDING) continue;
+        if (started > 0) queue_push(&t.queue, job);
+        else finish_game(&t, job);     // No threads: play on this one
+    }
+    queue_close(&t.queue);
+    for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+    free(workers);
+    fprintf(stderr, "\n");
+    fclose(t.journal);
+
+    Standing *table = malloc(roster.count * sizeof *table);
+    int status = 0;
+    if (table) {
+        rate(&t, table);
+        write_table(stdout, &t, table);
+        FILE *out = fopen(opts->results_path, "w");
+        if (out) {
+            write_table(out, &t, table);
+            fclose(out);
+            printf("\nResults written to %s\n", opts->results_path);
+        } else {
+            fprintf(stderr, "Could not write %s\n", opts->results_path);
+            status = 1;
+        }
+        free(table);
+    }
+
+    pthread_cond_destroy(&t.queue.not_full);
+    pthread_cond_destroy(&t.queue.not_empty);
+    pthread_mutex_destroy(&t.queue.lock);
+    pthread_mutex_destroy(&t.lock);
+    free(t.pairs); free(t.results);
+    free_roster(&roster);
+    return status;
+}
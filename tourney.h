@@ -0,0 +1,25 @@
+#ifndef TOURNEY_H
+#define TOURNEY_H
+
+#include <stdbool.h>
+
+#define TOURNEY_QUEUE_SIZE 64       // Games waiting for a worker
+#define TOURNEY_MAX_ROUNDS 200      // Longer games are scored as draws
+#define TOURNEY_ELO_START 1500.0
+#define TOURNEY_ELO_K 24.0
+
+typedef struct {
+    const char *roster_path;
+    const char *results_path;   // Results table; finished games go to results_path + ".journal"
+    int games;                  // Games per pair of armies
+    int jobs;                   // Worker threads, 0 = one per core
+    bool simultaneous;          // Play with simultaneous rounds
+    bool fog;                   // Play with fog of war
+} TournamentOptions;
+
+// Plays every pair of armies in the roster `games` times and ranks them by
+// Elo. Games already in the journal are not replayed, so an interrupted
+// tournament continues where it stopped when run again. Returns 0 on success.
+int run_tournament(const TournamentOptions *opts);
+
+#endif // TOURNEY_H
@@ -0,0 +1,132 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "trace.h"
+
+#define TRACE_MAX_DEPTH 64          // Open scopes remembered per thread when dumping
+
+typedef struct {
+    const char *name;
+    uint64_t ns;
+    char phase;                     // 'B' or 'E'
+} TraceEvent;
+
+typedef struct {
+    TraceEvent events[TRACE_RING_EVENTS];
+    uint64_t head;                  // Events written; the ring keeps the newest
+    const char *thread_name;
+    int tid;
+} TraceRing;
+
+bool trace_on = false;
+
+static TraceRing *rings[TRACE_MAX_THREADS];
+static int ring_count;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread TraceRing *thread_ring;
+static __thread bool thread_untraced;   // Registry was full or out of memory
+static const char *exit_path;
+static uint64_t start_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// The calling thread's ring, registered on its first event
+static TraceRing *get_ring(void) {
+    if (thread_ring || thread_untraced) return thread_ring;
+
+    pthread_mutex_lock(&rings_lock);
+    TraceRing *ring = ring_count < TRACE_MAX_THREADS ? calloc(1, sizeof(TraceRing)) : NULL;
+    if (ring) {
+        ring->tid = ring_count + 1;
+        rings[ring_count++] = ring;
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    thread_ring = ring;
+    thread_untraced = !ring;
+    return ring;
+}
+
+void trace_event(const char *name, char phase) {
+    TraceRing *ring = get_ring();
+    if (!ring) return;
+    TraceEvent *ev = &ring->events[ring->head & (TRACE_RING_EVENTS - 1)];
+    ev->name = name;
+    ev->ns = now_ns();
+    ev->phase = phase;
+    ring->head++;
+}
+
+void trace_thread_name(const char *name) {
+    if (!trace_on) return;
+    TraceRing *ring = get_ring();
+    if (ring) ring->thread_name = name;
+}
+
+static void dump_at_exit(void) {
+    trace_on = false;
+    if (!trace_dump(exit_path)) fprintf(stderr, "Could not write trace to %s\n", exit_path);
+}
+
+bool trace_start(const char *path) {
+    if (exit_path) return false;
+    exit_path = path;
+    start_ns = now_ns();
+    trace_on = true;
+    return atexit(dump_at_exit) == 0;
+}
+
+static void write_event(FILE *f, bool *first, const TraceRing *ring, const char *name, char phase, uint64_t ns) {
+    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+            *first ? "" : ",\n", name, phase, (double)(ns - start_ns) / 1000.0, ring->tid);
+    *first = false;
+}
+
+// Other threads must have stopped tracing. Ends whose begin was overwritten
+// are dropped, and scopes still open are closed at the time of the dump.
+bool trace_dump(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+
+    uint64_t end_ns = now_ns();
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&rings_lock);
+    for (int r = 0; r < ring_count; r++) {
+        const TraceRing *ring = rings[r];
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+                first ? "" : ",\n", ring->tid);
+        if (ring->thread_name) fprintf(f, "%s\"}}", ring->thread_name);
+        else fprintf(f, "thread %d\"}}", ring->tid);
+        first = false;
+
+        const char *open[TRACE_MAX_DEPTH];
+        int depth = 0;
+        uint64_t oldest = ring->head > TRACE_RING_EVENTS ? ring->head - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = oldest; i < ring->head; i++) {
+            const TraceEvent *ev = &ring->events[i & (TRACE_RING_EVENTS - 1)];
+            if (ev->phase == 'E') {
+                if (depth == 0) continue;
+                depth--;
+            } else {
+                if (depth < TRACE_MAX_DEPTH) open[depth] = ev->name;
+                depth++;
+            }
+            write_event(f, &first, ring, ev->name, ev->phase, ev->ns);
+        }
+        while (depth-- > 0) {
+            if (depth < TRACE_MAX_DEPTH) write_event(f, &first, ring, open[depth], 'E', end_ns);
+        }
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
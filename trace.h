@@ -0,0 +1,54 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// Timeline tracing, dumped as Chrome trace JSON (chrome://tracing, Perfetto).
+// Each thread writes begin/end events into its own ring, so recording takes
+// no lock; when a ring fills up the oldest events are overwritten. While
+// tracing is off every macro below costs a single predicted branch.
+#define TRACE_RING_EVENTS 32768     // Per thread, a power of two
+#define TRACE_MAX_THREADS 32        // Threads past this go untraced
+
+extern bool trace_on;
+
+void trace_event(const char *name, char phase);
+
+// Starts recording and writes the trace to `path` when the program exits
+bool trace_start(const char *path);
+
+// Label for the calling thread in the trace viewer
+void trace_thread_name(const char *name);
+
+// Writes everything recorded so far; false if the file couldn't be written
+bool trace_dump(const char *path);
+
+// Names must be string literals: only the pointer is stored
+static inline void trace_begin(const char *name) {
+    if (__builtin_expect(trace_on, 0)) trace_event(name, 'B');
+}
+
+static inline void trace_end(const char *name) {
+    if (__builtin_expect(trace_on, 0)) trace_event(name, 'E');
+}
+
+static inline const char *trace_scope_begin(const char *name) {
+    if (__builtin_expect(trace_on, 0)) {
+        trace_event(name, 'B');
+        return name;
+    }
+    return NULL;
+}
+
+static inline void trace_scope_end(const char **name) {
+    if (*name) trace_event(*name, 'E');
+}
+
+// Traces from here to the end of the enclosing block, however it is left
+#define TRACE_JOIN_(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN_(a, b)
+#define TRACE_SCOPE(name) \
+    const char *TRACE_JOIN(trace_scope_, __LINE__) __attribute__((cleanup(trace_scope_end), unused)) = \
+        trace_scope_begin(name)
+
+#endif // TRACE_H
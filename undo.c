@@ -0,0 +1,101 @@
+#include <string.h>
+#include "undo.h"
+
+static UnitState capture(const UndoHistory *h, const Battlefield *bf, int u) {
+    const UnitSlot *slot = unit_slot(bf, h->handles[u]);
+    UnitState s = {-1, -1, (int16_t)h->units[u]->hp, {{{0}}}, 0};
+    if (slot) {
+        int idx = (int)(slot - bf->slots);
+        s.x = (int8_t)slot->pos.x;
+        s.y = (int8_t)slot->pos.y;
+        get_unit_effects(bf, idx, &s.fx);
+        s.ready = bf->initiative.ready[idx];
+    }
+    return s;
+}
+
+static bool same_state(const UnitState *a, const UnitState *b) {
+    return a->x == b->x && a->y == b->y && a->hp == b->hp && a->ready == b->ready &&
+           memcmp(&a->fx, &b->fx, sizeof(a->fx)) == 0;
+}
+
+static bool same_cell(const UnitState *a, const UnitState *b) {
+    return a->x >= 0 && a->x == b->x && a->y == b->y;
+}
+
+void undo_init(UndoHistory *h, const Battlefield *bf) {
+    memset(h, 0, sizeof(*h));
+    for (int t = 0; t < 2; t++) {
+        for (int i = 0; i < bf->unit_counts[t]; i++) {
+            int u = h->unit_count++;
+            h->handles[u] = bf->roster[t][i];
+            h->units[u] = unit_slot(bf, h->handles[u])->unit;
+            h->teams[u] = (uint8_t)(t + 1);
+            h->current[u] = capture(h, bf, u);
+        }
+    }
+}
+
+void undo_record(UndoHistory *h, const Battlefield *bf, int turn_before, int turn_after) {
+    if (h->done == UNDO_DEPTH) {
+        h->first = (h->first + 1) % UNDO_DEPTH;
+        h->done--;
+    }
+    UndoStep *step = &h->steps[(h->first + h->done) % UNDO_DEPTH];
+    step->count = 0;
+    step->turn_before = (uint8_t)turn_before;
+    step->turn_after = (uint8_t)turn_after;
+    for (int u = 0; u < h->unit_count; u++) {
+        UnitState now = capture(h, bf, u);
+        if (same_state(&now, &h->current[u])) continue;
+        step->changes[step->count++] = (UnitChange){(uint8_t)u, h->current[u], now};
+        h->current[u] = now;
+    }
+    h->total = ++h->done;
+}
+
+// Puts every unit the step touched into its state on one side of the step.
+// Units that change cell are all lifted before any is put back, so a unit
+// never lands on a cell that another one is about to leave.
+static void apply_step(UndoHistory *h, Battlefield *bf, const UndoStep *step, bool forward) {
+    for (int i = 0; i < step->count; i++) {
+        const UnitChange *c = &step->changes[i];
+        const UnitState *from = &h->current[c->unit];
+        const UnitState *to = forward ? &c->after : &c->before;
+        if (from->x >= 0 && !same_cell(from, to)) remove_unit(bf, from->x, from->y);
+    }
+    for (int i = 0; i < step->count; i++) {
+        const UnitChange *c = &step->changes[i];
+        const UnitState *from = &h->current[c->unit];
+        const UnitState *to = forward ? &c->after : &c->before;
+        UNIT *unit = h->units[c->unit];
+        if (same_cell(from, to)) {
+            damage_unit(bf, to->x, to->y, unit->hp - to->hp);
+        } else {
+            unit->hp = to->hp;
+            if (to->x >= 0) h->handles[c->unit] = place_unit(bf, unit, h->teams[c->unit], to->x, to->y);
+        }
+        if (to->x >= 0) {
+            int slot = HANDLE_SLOT(h->handles[c->unit]);
+            set_unit_effects(bf, slot, &to->fx);
+            initiative_set(bf, slot, to->ready);
+        }
+        h->current[c->unit] = *to;
+    }
+}
+
+bool undo_step(UndoHistory *h, Battlefield *bf, int *turn) {
+    if (h->done == 0) return false;
+    const UndoStep *step = &h->steps[(h->first + --h->done) % UNDO_DEPTH];
+    apply_step(h, bf, step, false);
+    *turn = step->turn_before;
+    return true;
+}
+
+bool redo_step(UndoHistory *h, Battlefield *bf, int *turn) {
+    if (h->done == h->total) return false;
+    const UndoStep *step = &h->steps[(h->first + h->done++) % UNDO_DEPTH];
+    apply_step(h, bf, step, true);
+    *turn = step->turn_after;
+    return true;
+}
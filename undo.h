@@ -0,0 +1,57 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "battlefield.h"
+
+#define UNDO_DEPTH 64           // Actions kept; older ones fall off the ring
+
+// What an action can change about a unit
+typedef struct {
+    int8_t x, y;                // x < 0 once the unit has left the board
+    int16_t hp;
+    UnitEffects fx;             // Effects still running, counted from the current tick
+    uint32_t ready;             // Initiative time of its next turn
+} UnitState;
+
+typedef struct {
+    uint8_t unit;               // Index into UndoHistory.units
+    UnitState before, after;
+} UnitChange;
+
+// One action: the units it touched, before and after, and whose turn it
+// was on either side. Holding both ends makes a step its own inverse.
+typedef struct {
+    uint8_t count;
+    uint8_t turn_before, turn_after;
+    UnitChange changes[UNIT_SLOTS];
+} UndoStep;
+
+// Bounded undo/redo log. Steps live in a ring: recording past UNDO_DEPTH
+// drops the oldest step, recording after an undo drops the redo tail.
+typedef struct {
+    UNIT *units[UNIT_SLOTS];    // Every unit in the battle, dead ones included
+    uint8_t teams[UNIT_SLOTS];
+    UnitHandle handles[UNIT_SLOTS];
+    UnitState current[UNIT_SLOTS]; // Each unit as of the newest applied step
+    int unit_count;
+
+    UndoStep steps[UNDO_DEPTH];
+    int first;                  // Ring index of the oldest step
+    int done;                   // Steps that can be undone
+    int total;                  // Steps held; those past `done` can be redone
+} UndoHistory;
+
+// Starts an empty history over the units on the board
+void undo_init(UndoHistory *h, const Battlefield *bf);
+
+// Records what changed on the board since the last step
+void undo_record(UndoHistory *h, const Battlefield *bf, int turn_before, int turn_after);
+
+// Step back or forward one action, setting *turn to whose turn it is
+// then. Both return false when there is nothing to step over.
+bool undo_step(UndoHistory *h, Battlefield *bf, int *turn);
+bool redo_step(UndoHistory *h, Battlefield *bf, int *turn);
+
+#endif // UNDO_H